@@ -0,0 +1,370 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like clock_gettime
+#define _POSIX_C_SOURCE 200809L
+// Microbenchmarks of the crawler's per-page work over a recorded corpus, without the network:
+// word counting (word_finder), link extraction, URL resolution, and visited-set insert/lookup.
+// The corpus is the page store of an earlier crawl and/or HTML files. Every benchmark runs
+// over the whole corpus `reps` times (after one warm-up pass) and reports the median,
+// minimum and spread of the time per byte or per operation.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "../html_parse.h"
+#include "../visited_set.h"
+#include "../page_reader.h"
+
+#define MAX_URL_LENGTH 1000 // Same URL buffer size as the crawler
+#define DEFAULT_REPS 15
+#define DEFAULT_STORE "store"
+
+// One page of the corpus, NUL-terminated like a downloaded body
+typedef struct {
+    char *url;
+    char *html;
+    size_t length;
+} CorpusPage;
+
+// One link as found on a page, for the URL resolution benchmark
+typedef struct {
+    const char *page_url;
+    char *link;
+} CorpusLink;
+
+typedef struct {
+    CorpusPage *pages;
+    size_t count;
+    size_t capacity;
+    size_t bytes;
+    CorpusLink *links;
+    size_t link_count;
+    char **urls;        // Resolved same-site URLs, in crawl order, for the visited-set benchmarks
+    size_t url_count;
+} Corpus;
+
+// Same words as the crawler counts
+static const char *important_words[] = {"data", "star", "math", "generate", "link", "information"};
+#define WORD_COUNT (int)(sizeof(important_words) / sizeof(important_words[0]))
+
+static volatile uint64_t sink; // Results are folded in here so no benchmarked work is optimized away
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static void *grow(void *array, size_t *capacity, size_t count, size_t size) {
+    if (count < *capacity) {
+        return array;
+    }
+    size_t new_capacity = *capacity ? *capacity * 2 : 64;
+    void *grown = realloc(array, new_capacity * size);
+    if (!grown) {
+        fprintf(stderr, "Out of memory loading the corpus\n");
+        exit(1);
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+static char *copy(const char *data, size_t length) {
+    char *text = malloc(length + 1);
+    if (!text) {
+        fprintf(stderr, "Out of memory loading the corpus\n");
+        exit(1);
+    }
+    memcpy(text, data, length);
+    text[length] = '\0';
+    return text;
+}
+
+static void add_page(Corpus *corpus, const char *url, const char *html, size_t length) {
+    corpus->pages = grow(corpus->pages, &corpus->capacity, corpus->count, sizeof(CorpusPage));
+    corpus->pages[corpus->count++] = (CorpusPage){copy(url, strlen(url)), copy(html, length), length};
+    corpus->bytes += length;
+}
+
+/**
+ * Adds every page of a page store to the corpus. Returns the number of pages added, or -1 if
+ * the store cannot be opened.
+ */
+static long load_store(Corpus *corpus, const char *dir) {
+    PageStore store;
+    if (page_store_open(dir, &store) != 0) {
+        return -1;
+    }
+    long added = 0;
+    for (uint64_t id = 0; id < page_store_page_limit(&store); id++) {
+        StoredPage page;
+        if (page_store_get(&store, (uint32_t)id, &page) == 0) {
+            add_page(corpus, page.url, page.body, page.length);
+            added++;
+        }
+    }
+    page_store_close(&store);
+    return added;
+}
+
+/**
+ * Adds an HTML file to the corpus, using its path as its URL. Returns 0 on success, -1 on failure.
+ */
+static int load_file(Corpus *corpus, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+    char *data = NULL;
+    size_t length = 0, capacity = 0, n;
+    char chunk[65536];
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        while (length + n > capacity) {
+            data = grow(data, &capacity, capacity, 1);
+        }
+        memcpy(data + length, chunk, n);
+        length += n;
+    }
+    int failed = ferror(file);
+    fclose(file);
+    if (!failed) {
+        add_page(corpus, path, data ? data : "", length);
+    }
+    free(data);
+    return failed ? -1 : 0;
+}
+
+/**
+ * Collects the links of every page and their resolved same-site URLs, as the crawler would.
+ */
+static void collect_links(Corpus *corpus, const char *start_url) {
+    size_t link_capacity = 0, url_capacity = 0;
+    char link[MAX_URL_LENGTH], resolved[MAX_URL_LENGTH];
+    for (size_t i = 0; i < corpus->count; i++) {
+        char *lower = html_lowercase(corpus->pages[i].html);
+        if (!lower) {
+            continue;
+        }
+        const char *cursor = lower;
+        while ((cursor = html_next_link(cursor, link, sizeof(link))) != NULL) {
+            corpus->links = grow(corpus->links, &link_capacity, corpus->link_count, sizeof(CorpusLink));
+            corpus->links[corpus->link_count++] = (CorpusLink){corpus->pages[i].url, copy(link, strlen(link))};
+            if (url_resolve(start_url, corpus->pages[i].url, link, resolved, sizeof(resolved)) == URL_RESOLVED_CRAWL) {
+                corpus->urls = grow(corpus->urls, &url_capacity, corpus->url_count, sizeof(char *));
+                corpus->urls[corpus->url_count++] = copy(resolved, strlen(resolved));
+            }
+        }
+        free(lower);
+    }
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Prints one result line from the per-repetition times (ns per unit): median, minimum,
+ * maximum and the relative standard deviation across repetitions.
+ */
+static void report(const char *name, const char *unit, double *samples, int reps) {
+    double mean = 0, variance = 0;
+    for (int i = 0; i < reps; i++) {
+        mean += samples[i];
+    }
+    mean /= reps;
+    for (int i = 0; i < reps; i++) {
+        variance += (samples[i] - mean) * (samples[i] - mean);
+    }
+    double stddev = reps > 1 ? sqrt(variance / (reps - 1)) : 0;
+    qsort(samples, reps, sizeof(double), compare_double);
+    double median = reps % 2 ? samples[reps / 2] : (samples[reps / 2 - 1] + samples[reps / 2]) / 2;
+    printf("%-22s %12.3f %12.3f %12.3f %7.1f%%  ns/%s\n", name, median, samples[0], samples[reps - 1],
+           mean > 0 ? 100 * stddev / mean : 0.0, unit);
+}
+
+static uint64_t run_words(const Corpus *corpus) {
+    uint64_t result = 0;
+    int counts[WORD_COUNT];
+    for (size_t i = 0; i < corpus->count; i++) {
+        result += html_count_words(corpus->pages[i].html, important_words, WORD_COUNT, counts) + counts[0];
+    }
+    return result;
+}
+
+static uint64_t run_links(const Corpus *corpus) {
+    uint64_t result = 0;
+    char link[MAX_URL_LENGTH];
+    for (size_t i = 0; i < corpus->count; i++) {
+        char *lower = html_lowercase(corpus->pages[i].html);
+        if (!lower) {
+            continue;
+        }
+        const char *cursor = lower;
+        while ((cursor = html_next_link(cursor, link, sizeof(link))) != NULL) {
+            result += (unsigned char)link[0];
+        }
+        free(lower);
+    }
+    return result;
+}
+
+static uint64_t run_resolve(const Corpus *corpus, const char *start_url) {
+    uint64_t result = 0;
+    char resolved[MAX_URL_LENGTH];
+    for (size_t i = 0; i < corpus->link_count; i++) {
+        result += url_resolve(start_url, corpus->links[i].page_url, corpus->links[i].link, resolved, sizeof(resolved));
+        result += (unsigned char)resolved[0];
+    }
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    Corpus corpus = {0};
+    const char *store_dir = NULL;
+    const char *start_url = NULL;
+    int reps = DEFAULT_REPS;
+    size_t visited_capacity = MAX_URL_LENGTH;
+    int files = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) {
+            store_dir = argv[++i];
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--url") == 0 && i + 1 < argc) {
+            start_url = argv[++i];
+        } else if (strcmp(argv[i], "--visited-capacity") == 0 && i + 1 < argc) {
+            visited_capacity = (size_t)atol(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            if (load_file(&corpus, argv[i]) != 0) {
+                perror(argv[i]);
+                return 1;
+            }
+            files++;
+        } else {
+            fprintf(stderr, "Usage: %s [--store DIR] [--url START_URL] [--reps N] [--visited-capacity N] [FILE.html]...\n"
+                            "Benchmarks over the pages of a page store (default ./%s) and/or HTML files.\n",
+                    argv[0], DEFAULT_STORE);
+            return 2;
+        }
+    }
+    if (store_dir || !files) {
+        const char *dir = store_dir ? store_dir : DEFAULT_STORE;
+        if (load_store(&corpus, dir) < 0 && store_dir) {
+            perror(dir);
+            return 1;
+        }
+    }
+    if (corpus.count == 0) {
+        fprintf(stderr, "No pages to benchmark: crawl first (./crawler, or BENCH_STORE=store make bench),\n"
+                        "or pass --store DIR or HTML files\n");
+        return 1;
+    }
+    if (reps < 1) {
+        reps = 1;
+    }
+    if (!start_url) {
+        start_url = corpus.pages[0].url; // The first stored page is where the crawl started
+    }
+    collect_links(&corpus, start_url);
+    if (visited_capacity > corpus.url_count) {
+        visited_capacity = corpus.url_count;
+    }
+
+    printf("Corpus: %zu pages, %.1f KB, %zu links, %zu same-site URLs; start URL %s\n", corpus.count,
+           corpus.bytes / 1024.0, corpus.link_count, corpus.url_count, start_url);
+    printf("%d repetitions after one warm-up pass\n\n", reps);
+    printf("%-22s %12s %12s %12s %8s\n", "benchmark", "median", "min", "max", "stddev");
+
+    double *samples = malloc((size_t)reps * sizeof(double));
+    double *samples_per_op = malloc((size_t)reps * sizeof(double));
+    if (!samples || !samples_per_op) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    double bytes = corpus.bytes ? (double)corpus.bytes : 1;
+    double links = corpus.link_count ? (double)corpus.link_count : 1;
+
+    // Word counting and SimHash (word_finder without logging)
+    for (int r = -1; r < reps; r++) {
+        uint64_t start = now_ns();
+        sink += run_words(&corpus);
+        uint64_t elapsed = now_ns() - start;
+        if (r >= 0) {
+            samples[r] = elapsed / bytes;
+            samples_per_op[r] = elapsed / (double)corpus.count;
+        }
+    }
+    report("word_finder", "byte", samples, reps);
+    report("word_finder", "page", samples_per_op, reps);
+
+    // Link extraction: lowercasing plus the scan for link attributes
+    for (int r = -1; r < reps; r++) {
+        uint64_t start = now_ns();
+        sink += run_links(&corpus);
+        uint64_t elapsed = now_ns() - start;
+        if (r >= 0) {
+            samples[r] = elapsed / bytes;
+            samples_per_op[r] = elapsed / links;
+        }
+    }
+    report("link extraction", "byte", samples, reps);
+    report("link extraction", "link", samples_per_op, reps);
+
+    // URL resolution of every extracted link
+    for (int r = -1; r < reps; r++) {
+        uint64_t start = now_ns();
+        sink += run_resolve(&corpus, start_url);
+        uint64_t elapsed = now_ns() - start;
+        if (r >= 0) {
+            samples[r] = elapsed / links;
+        }
+    }
+    report("url_resolve", "link", samples, reps);
+
+    // Visited set: insert (check and add) every same-site URL in crawl order into a set of the
+    // crawler's capacity, then look every URL up in the filled set
+    if (corpus.url_count > 0) {
+        double *lookup_samples = samples_per_op;
+        for (int r = -1; r < reps; r++) {
+            VisitedSet set;
+            if (visited_set_init(&set, visited_capacity) != 0) {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+            }
+            uint64_t start = now_ns();
+            for (size_t i = 0; i < corpus.url_count; i++) {
+                sink += visited_set_add(&set, corpus.urls[i]);
+            }
+            uint64_t inserted = now_ns();
+            for (size_t i = 0; i < corpus.url_count; i++) {
+                sink += visited_set_contains(&set, corpus.urls[i]);
+            }
+            uint64_t looked_up = now_ns();
+            if (r >= 0) {
+                samples[r] = (inserted - start) / (double)corpus.url_count;
+                lookup_samples[r] = (looked_up - inserted) / (double)corpus.url_count;
+            }
+            visited_set_destroy(&set);
+        }
+        report("visited insert", "op", samples, reps);
+        report("visited lookup", "op", lookup_samples, reps);
+    }
+
+    free(samples);
+    free(samples_per_op);
+    for (size_t i = 0; i < corpus.count; i++) {
+        free(corpus.pages[i].url);
+        free(corpus.pages[i].html);
+    }
+    for (size_t i = 0; i < corpus.link_count; i++) {
+        free(corpus.links[i].link);
+    }
+    for (size_t i = 0; i < corpus.url_count; i++) {
+        free(corpus.urls[i]);
+    }
+    free(corpus.pages);
+    free(corpus.links);
+    free(corpus.urls);
+    return 0;
+}
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Crawls a local synthetic site and reports throughput, fetch latency and peak memory.
+# Settings can be overridden from the environment, e.g.
+#   BENCH_SITE="--pages 2000 --latency-ms 50 --latency-dist exp" make bench
+# BENCH_STORE=DIR keeps the crawled page store in DIR (e.g. as a corpus for `make microbench`).
+set -e
+
+PORT=${BENCH_PORT:-8089}
+SITE=${BENCH_SITE:---pages 1000 --size 20000 --fanout 8 --latency-ms 20 --latency-dist exp --error-rate 0.01 --seed 1}
+CRAWL=${BENCH_CRAWL:---max-depth 4 --max-urls-per-depth 200 --stats-interval 0}
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+server=$("$root/bench/synth_server" --port "$PORT" --background $SITE)
+trap 'kill "$server" 2>/dev/null; rm -rf "$work"' EXIT
+
+echo "Site:  $SITE"
+echo "Crawl: $CRAWL"
+cd "$work"
+"$root/crawler" --url "http://127.0.0.1:$PORT/p/0.html" $CRAWL > crawl.txt 2> errors.txt
+grep -E "^(Crawl summary|Stage time summary|Peak memory):" crawl.txt
+cd - > /dev/null
+if [ -n "$BENCH_STORE" ]; then
+    rm -rf "$BENCH_STORE"
+    cp -r "$work/store" "$BENCH_STORE"
+fi
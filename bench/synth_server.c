@@ -0,0 +1,307 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like sockets and nanosleep
+#define _POSIX_C_SOURCE 200809L
+// Local HTTP server generating a deterministic synthetic site for benchmarks.
+// Page N lives at /p/N.html and links to `fanout` other pages chosen from a seeded hash,
+// so the same options always produce the same site, latencies and errors.
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define REQUEST_MAX 4096
+
+// Words used for page text; includes every word the crawler counts
+static const char *vocabulary[] = {
+    "data", "star", "math", "generate", "link", "information", "travel", "book", "page", "crawler",
+    "graph", "river", "mountain", "city", "market", "history", "science", "garden", "music", "ocean",
+    "engine", "letter", "window", "forest", "signal", "network", "winter", "summer", "bridge", "story"};
+#define VOCABULARY_SIZE (sizeof(vocabulary) / sizeof(vocabulary[0]))
+
+// Site and server settings, fixed after startup
+typedef struct {
+    int port;
+    long pages;          // Number of pages on the site
+    long size;           // Approximate body size in bytes
+    int fanout;          // Links per page
+    double latency_ms;   // Mean response latency
+    char distribution;   // 'f' = fixed, 'u' = uniform in [0, 2 * mean], 'e' = exponential
+    double error_rate;   // Fraction of pages answered with 500
+    uint64_t seed;
+    int background;      // Detach once listening and print the server pid
+} SiteOptions;
+
+static SiteOptions site = {8089, 1000, 20000, 8, 0.0, 'f', 0.0, 1, 0};
+
+/**
+ * SplitMix64: a well-mixed hash of the seed and two inputs.
+ */
+static uint64_t mix(uint64_t a, uint64_t b) {
+    uint64_t z = site.seed * 0x9E3779B97F4A7C15ULL + a * 0xBF58476D1CE4E5B9ULL + b * 0x94D049BB133111EBULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Returns a deterministic number in [0, 1) for a page and purpose.
+ */
+static double unit(long page, uint64_t purpose) {
+    return (mix((uint64_t)page, purpose) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Returns the response latency of a page in milliseconds.
+ */
+static double page_latency(long page) {
+    double u = unit(page, 1);
+    switch (site.distribution) {
+    case 'u':
+        return 2.0 * site.latency_ms * u;
+    case 'e':
+        return -site.latency_ms * log(1.0 - u);
+    default:
+        return site.latency_ms;
+    }
+}
+
+/**
+ * Appends formatted text to a growable buffer. Returns 0 on success, -1 if memory runs out.
+ */
+static int append(char **buffer, size_t *length, size_t *capacity, const char *format, ...) {
+    va_list args;
+    while (1) {
+        va_start(args, format);
+        int n = vsnprintf(*buffer + *length, *capacity - *length, format, args);
+        va_end(args);
+        if (n < 0) {
+            return -1;
+        }
+        if ((size_t)n < *capacity - *length) {
+            *length += (size_t)n;
+            return 0;
+        }
+        size_t new_capacity = *capacity * 2 + (size_t)n;
+        char *grown = realloc(*buffer, new_capacity);
+        if (!grown) {
+            return -1;
+        }
+        *buffer = grown;
+        *capacity = new_capacity;
+    }
+}
+
+/**
+ * Builds the HTML of a page: its links first, then filler paragraphs up to the target size.
+ * Returns the body (to be freed by the caller) or NULL if memory runs out.
+ */
+static char *build_page(long page, size_t *length) {
+    size_t capacity = (size_t)site.size + 4096;
+    char *body = malloc(capacity);
+    if (!body) {
+        return NULL;
+    }
+    *length = 0;
+    int ok = append(&body, length, &capacity, "<html><head><title>Page %ld</title></head><body>\n<h1>Page %ld</h1>\n<ul>\n",
+                    page, page) == 0;
+    for (int i = 0; ok && i < site.fanout; i++) {
+        long target = (long)(mix((uint64_t)page, 1000 + (uint64_t)i) % (uint64_t)site.pages);
+        ok = append(&body, length, &capacity, "<li><a href=\"http://127.0.0.1:%d/p/%ld.html\">Page %ld</a></li>\n",
+                    site.port, target, target) == 0;
+    }
+    ok = ok && append(&body, length, &capacity, "</ul>\n<p>") == 0;
+    for (uint64_t word = 0; ok && *length < (size_t)site.size; word++) {
+        const char *text = vocabulary[mix((uint64_t)page, 100000 + word) % VOCABULARY_SIZE];
+        ok = append(&body, length, &capacity, word % 64 == 63 ? "%s</p>\n<p>" : "%s ", text) == 0;
+    }
+    ok = ok && append(&body, length, &capacity, "</p>\n</body></html>\n") == 0;
+    if (!ok) {
+        free(body);
+        return NULL;
+    }
+    return body;
+}
+
+static void write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n <= 0) {
+            return;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+}
+
+static void respond(int client, int status, const char *reason, const char *body, size_t length) {
+    char header[256];
+    int header_length = snprintf(header, sizeof(header),
+                                 "HTTP/1.0 %d %s\r\nContent-Type: text/html\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                                 status, reason, length);
+    write_all(client, header, (size_t)header_length);
+    write_all(client, body, length);
+}
+
+/**
+ * Serves one request on its own thread: parses the page number, waits out the page's
+ * latency, then answers with the page, a 500 for error pages, or a 404.
+ */
+static void *serve_client(void *arg) {
+    int client = (int)(intptr_t)arg;
+    char request[REQUEST_MAX];
+    size_t received = 0;
+    while (received < sizeof(request) - 1) {
+        ssize_t n = read(client, request + received, sizeof(request) - 1 - received);
+        if (n <= 0) {
+            break;
+        }
+        received += (size_t)n;
+        request[received] = '\0';
+        if (strstr(request, "\r\n\r\n")) {
+            break;
+        }
+    }
+    request[received] = '\0';
+
+    long page = -1;
+    char path[256];
+    if (sscanf(request, "GET %255s", path) == 1) {
+        char *end;
+        if (strncmp(path, "/p/", 3) == 0) {
+            page = strtol(path + 3, &end, 10);
+            if (end == path + 3 || strcmp(end, ".html") != 0 || page < 0 || page >= site.pages) {
+                page = -1;
+            }
+        }
+    }
+    if (page < 0) {
+        respond(client, 404, "Not Found", "not found\n", 10);
+    } else {
+        double delay = page_latency(page);
+        struct timespec ts = {(time_t)(delay / 1000), (long)(fmod(delay, 1000.0) * 1e6)};
+        nanosleep(&ts, NULL);
+        if (unit(page, 2) < site.error_rate) {
+            respond(client, 500, "Internal Server Error", "error\n", 6);
+        } else {
+            size_t length;
+            char *body = build_page(page, &length);
+            if (body) {
+                respond(client, 200, "OK", body, length);
+                free(body);
+            } else {
+                respond(client, 500, "Internal Server Error", "out of memory\n", 14);
+            }
+        }
+    }
+    close(client);
+    return NULL;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--port N] [--pages N] [--size BYTES] [--fanout N] [--latency-ms MS]\n", program);
+    fprintf(stderr, "          [--latency-dist fixed|uniform|exp] [--error-rate R] [--seed N] [--background]\n");
+    fprintf(stderr, "Serves http://127.0.0.1:PORT/p/0.html ... /p/(pages-1).html\n");
+}
+
+static int parse_options(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--port") == 0 && has_value) {
+            site.port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pages") == 0 && has_value) {
+            site.pages = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && has_value) {
+            site.size = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--fanout") == 0 && has_value) {
+            site.fanout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--latency-ms") == 0 && has_value) {
+            site.latency_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--latency-dist") == 0 && has_value) {
+            site.distribution = argv[++i][0];
+            if (strcmp(argv[i], "fixed") != 0 && strcmp(argv[i], "uniform") != 0 && strcmp(argv[i], "exp") != 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--error-rate") == 0 && has_value) {
+            site.error_rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            site.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--background") == 0) {
+            site.background = 1;
+        } else {
+            return -1;
+        }
+    }
+    return site.pages > 0 && site.size >= 0 && site.fanout >= 0 && site.port > 0 ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    if (parse_options(argc, argv) != 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN); // Clients that hang up early must not kill the server
+
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0) {
+        perror("Error creating socket");
+        return 1;
+    }
+    int reuse = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)site.port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(server, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(server, 128) != 0) {
+        perror("Error listening");
+        close(server);
+        return 1;
+    }
+
+    // Detach only once the socket is listening, so callers can start crawling right away
+    if (site.background) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("Error forking");
+            return 1;
+        }
+        if (pid > 0) {
+            printf("%ld\n", (long)pid);
+            return 0;
+        }
+        fclose(stdin);
+        fclose(stdout);
+    } else {
+        printf("Serving %ld pages on http://127.0.0.1:%d/p/0.html\n", site.pages, site.port);
+        fflush(stdout);
+    }
+
+    while (1) {
+        int client = accept(server, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Error accepting connection");
+            break;
+        }
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, serve_client, (void *)(intptr_t)client) != 0) {
+            close(client);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    close(server);
+    return 1;
+}
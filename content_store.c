@@ -0,0 +1,383 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like mkdir
+#define _POSIX_C_SOURCE 200809L
+#include "content_store.h"
+#include "url_table.h"
+#include "lock_profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define STORE_PATH_LENGTH 512
+
+// In-memory entry for a stored body, looked up by fingerprint
+typedef struct {
+    Fingerprint fp;
+    long body_id; // -1 marks an empty slot
+} BodySlot;
+
+static char store_dir[STORE_PATH_LENGTH];
+static FILE *segment_file = NULL;
+static FILE *bodies_file = NULL;
+static FILE *pages_file = NULL;
+static uint32_t segment_number = 0;
+static uint64_t segment_offset = 0;
+static BodySlot *body_slots = NULL; // Open-addressing hash table keyed by fingerprint
+static size_t body_capacity = 0;    // Always a power of two
+static long body_count = 0;
+static uint64_t *body_simhashes = NULL; // SimHash of each body by body id, once analyzed
+static unsigned char *simhash_known = NULL; // Whether each body's SimHash has been set
+static size_t simhash_capacity = 0;
+static int simhash_lost = 0;            // Set if a SimHash could not be kept, so waiters give up
+static pthread_cond_t simhash_cond = PTHREAD_COND_INITIALIZER; // Signaled when a SimHash is set
+static char **page_urls = NULL;    // URL of each page by page number (NULL = not stored)
+static long *page_bodies = NULL;   // Body id of each page by page number
+static size_t page_capacity = 0;
+static pthread_mutex_t store_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Opens segment file number `segment_number` for writing.
+ */
+static int open_segment(void) {
+    char path[STORE_PATH_LENGTH + 32];
+    snprintf(path, sizeof(path), "%s/segment_%u.dat", store_dir, segment_number);
+    segment_file = fopen(path, "wb");
+    segment_offset = 0;
+    return segment_file ? 0 : -1;
+}
+
+/**
+ * Finds the slot holding `fp`, or the empty slot where it would be inserted.
+ */
+static BodySlot *find_slot(BodySlot *slots, size_t capacity, const Fingerprint *fp) {
+    size_t i = (size_t)fp->lo & (capacity - 1);
+    while (slots[i].body_id != -1 && !fingerprint_equal(&slots[i].fp, fp)) {
+        i = (i + 1) & (capacity - 1); // Linear probing
+    }
+    return &slots[i];
+}
+
+/**
+ * Doubles the capacity of the fingerprint hash table.
+ */
+static int grow_table(void) {
+    size_t new_capacity = body_capacity ? body_capacity * 2 : 1024;
+    BodySlot *new_slots = malloc(new_capacity * sizeof(BodySlot));
+    if (!new_slots) {
+        return -1;
+    }
+    for (size_t i = 0; i < new_capacity; i++) {
+        new_slots[i].body_id = -1;
+    }
+    for (size_t i = 0; i < body_capacity; i++) {
+        if (body_slots[i].body_id != -1) {
+            *find_slot(new_slots, new_capacity, &body_slots[i].fp) = body_slots[i];
+        }
+    }
+    free(body_slots);
+    body_slots = new_slots;
+    body_capacity = new_capacity;
+    return 0;
+}
+
+/**
+ * Creates the store directory and opens a fresh set of store files.
+ * Returns 0 on success, -1 on failure (errno is left set by the failing call).
+ */
+int store_open(const char *dir) {
+    char path[STORE_PATH_LENGTH + 32];
+    snprintf(store_dir, sizeof(store_dir), "%s", dir);
+    if (mkdir(store_dir, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/%s", store_dir, STORE_BODIES_FILE);
+    bodies_file = fopen(path, "wb");
+    snprintf(path, sizeof(path), "%s/%s", store_dir, STORE_PAGES_FILE);
+    pages_file = fopen(path, "w");
+    segment_number = 0;
+    if (!bodies_file || !pages_file || open_segment() != 0 || grow_table() != 0) {
+        store_close();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Looks a body up by fingerprint, assigning it the next body id if it has not been seen.
+ * The body itself is written later with store_write_body, so duplicate detection does not
+ * wait for the disk. *is_new is set to 1 when the id was just assigned, 0 otherwise.
+ * Returns the body id, or -1 on allocation failure.
+ */
+long store_claim_body(const Fingerprint *fp, int *is_new) {
+    MUTEX_LOCK(&store_lock);
+    BodySlot *slot = find_slot(body_slots, body_capacity, fp);
+    if (slot->body_id != -1) {
+        long existing = slot->body_id;
+        MUTEX_UNLOCK(&store_lock);
+        *is_new = 0;
+        return existing;
+    }
+    // Keep the table at most half full so probe sequences stay short
+    if ((size_t)(body_count + 1) * 2 > body_capacity) {
+        if (grow_table() != 0) {
+            MUTEX_UNLOCK(&store_lock);
+            return -1;
+        }
+        slot = find_slot(body_slots, body_capacity, fp);
+    }
+    long body_id = body_count++;
+    slot->fp = *fp;
+    slot->body_id = body_id;
+    MUTEX_UNLOCK(&store_lock);
+    *is_new = 1;
+    return body_id;
+}
+
+/**
+ * Appends the body of a claimed id to the current segment and writes its record to
+ * bodies.idx. Bodies can be written out of id order, so each record goes to its own
+ * position in the file. Returns 0 on success, -1 on a write error or a body longer than
+ * STORE_MAX_BODY_LENGTH.
+ */
+int store_write_body(long body_id, const Fingerprint *fp, const char *data, size_t length) {
+    if (length > STORE_MAX_BODY_LENGTH) {
+        return -1;
+    }
+    MUTEX_LOCK(&store_lock);
+    // Start a new segment once the current one is full (an oversized body gets its own segment)
+    if (segment_offset > 0 && segment_offset + length > (uint64_t)STORE_SEGMENT_SIZE) {
+        fclose(segment_file);
+        segment_number++;
+        if (open_segment() != 0) {
+            MUTEX_UNLOCK(&store_lock);
+            return -1;
+        }
+    }
+
+    StoreBodyRecord record;
+    record.fp_hi = fp->hi;
+    record.fp_lo = fp->lo;
+    record.offset = segment_offset;
+    record.segment = segment_number;
+    record.length = (uint32_t)length;
+    if (fwrite(data, 1, length, segment_file) != length ||
+        fseek(bodies_file, body_id * (long)sizeof(record), SEEK_SET) != 0 ||
+        fwrite(&record, sizeof(record), 1, bodies_file) != 1) {
+        MUTEX_UNLOCK(&store_lock);
+        return -1;
+    }
+    segment_offset += length;
+    MUTEX_UNLOCK(&store_lock);
+    return 0;
+}
+
+/**
+ * Remembers the SimHash computed for a stored body so that later pages sharing
+ * the body can be recorded without analyzing it again, and wakes the pages waiting
+ * for it in store_body_simhash.
+ */
+int store_set_body_simhash(long body_id, uint64_t simhash) {
+    MUTEX_LOCK(&store_lock);
+    if ((size_t)body_id >= simhash_capacity) {
+        size_t new_capacity = simhash_capacity ? simhash_capacity : 1024;
+        while (new_capacity <= (size_t)body_id) {
+            new_capacity *= 2;
+        }
+        uint64_t *grown = realloc(body_simhashes, new_capacity * sizeof(uint64_t));
+        if (grown) {
+            body_simhashes = grown;
+        }
+        unsigned char *known = grown ? realloc(simhash_known, new_capacity) : NULL;
+        if (known) {
+            simhash_known = known;
+        }
+        if (!grown || !known) {
+            simhash_lost = 1;
+            pthread_cond_broadcast(&simhash_cond);
+            MUTEX_UNLOCK(&store_lock);
+            return -1;
+        }
+        memset(body_simhashes + simhash_capacity, 0, (new_capacity - simhash_capacity) * sizeof(uint64_t));
+        memset(simhash_known + simhash_capacity, 0, new_capacity - simhash_capacity);
+        simhash_capacity = new_capacity;
+    }
+    body_simhashes[body_id] = simhash;
+    simhash_known[body_id] = 1;
+    pthread_cond_broadcast(&simhash_cond);
+    MUTEX_UNLOCK(&store_lock);
+    return 0;
+}
+
+/**
+ * Returns the SimHash of a claimed body. The page that claimed the body as new sets it
+ * right after analyzing the body, so a duplicate page that gets here first waits for it.
+ * Returns 0 if the SimHash could not be kept.
+ */
+uint64_t store_body_simhash(long body_id) {
+    MUTEX_LOCK(&store_lock);
+    while (!simhash_lost && ((size_t)body_id >= simhash_capacity || !simhash_known[body_id])) {
+        COND_WAIT(&simhash_cond, &store_lock);
+    }
+    uint64_t simhash = (size_t)body_id < simhash_capacity && simhash_known[body_id] ? body_simhashes[body_id] : 0;
+    MUTEX_UNLOCK(&store_lock);
+    return simhash;
+}
+
+/**
+ * Records that the page fetched from `url` has the body `body_id` and text SimHash `simhash`.
+ * `truncated` marks a body that was cut off at the crawler's size limit.
+ */
+int store_add_page(int page_index, long body_id, const Fingerprint *fp, uint64_t simhash, int truncated, const char *url) {
+    char hex[FINGERPRINT_HEX_LENGTH];
+    fingerprint_to_hex(fp, hex);
+    char *url_copy = strdup(url);
+    if (!url_copy || page_index < 0) {
+        free(url_copy);
+        return -1;
+    }
+    MUTEX_LOCK(&store_lock);
+    // Remember the page for the lookup index written by store_close
+    if ((size_t)page_index >= page_capacity) {
+        size_t new_capacity = page_capacity ? page_capacity : 1024;
+        while (new_capacity <= (size_t)page_index) {
+            new_capacity *= 2;
+        }
+        char **urls = realloc(page_urls, new_capacity * sizeof(char *));
+        if (urls) {
+            page_urls = urls;
+        }
+        long *bodies = realloc(page_bodies, new_capacity * sizeof(long));
+        if (bodies) {
+            page_bodies = bodies;
+        }
+        if (!urls || !bodies) {
+            MUTEX_UNLOCK(&store_lock);
+            free(url_copy);
+            return -1;
+        }
+        memset(page_urls + page_capacity, 0, (new_capacity - page_capacity) * sizeof(char *));
+        page_capacity = new_capacity;
+    }
+    free(page_urls[page_index]);
+    page_urls[page_index] = url_copy;
+    page_bodies[page_index] = body_id;
+    int written = fprintf(pages_file, "%d\t%ld\t%s\t%016llx\t%d\t%s\n",
+                          page_index, body_id, hex, (unsigned long long)simhash, truncated ? 1 : 0, url);
+    MUTEX_UNLOCK(&store_lock);
+    return written < 0 ? -1 : 0;
+}
+
+/**
+ * Returns the number of unique bodies stored so far.
+ */
+long store_body_count(void) {
+    MUTEX_LOCK(&store_lock);
+    long count = body_count;
+    MUTEX_UNLOCK(&store_lock);
+    return count;
+}
+
+/**
+ * Writes pages.idx: one record per page number plus a URL hash table, so readers can
+ * find a page by number or URL with a single probe sequence over a memory map.
+ */
+static int write_page_index(void) {
+    char path[STORE_PATH_LENGTH + 32];
+    size_t page_count = 0, stored = 0;
+    for (size_t i = 0; i < page_capacity; i++) {
+        if (page_urls[i]) {
+            page_count = i + 1;
+            stored++;
+        }
+    }
+    size_t slot_count = 16;
+    while (slot_count < stored * 2) {
+        slot_count *= 2;
+    }
+    StorePageRecord *records = malloc((page_count ? page_count : 1) * sizeof(StorePageRecord));
+    uint32_t *slots = malloc(slot_count * sizeof(uint32_t));
+    if (!records || !slots) {
+        free(records);
+        free(slots);
+        return -1;
+    }
+    memset(slots, 0xff, slot_count * sizeof(uint32_t)); // All STORE_NO_PAGE
+    uint64_t url_bytes = 0;
+    for (size_t i = 0; i < page_count; i++) {
+        if (!page_urls[i]) {
+            records[i].body_id = STORE_NO_BODY;
+            records[i].url_offset = 0;
+            records[i].url_hash = 0;
+            continue;
+        }
+        records[i].body_id = (uint64_t)page_bodies[i];
+        records[i].url_offset = url_bytes;
+        records[i].url_hash = url_hash(page_urls[i]);
+        url_bytes += strlen(page_urls[i]) + 1;
+        size_t slot = (size_t)records[i].url_hash & (slot_count - 1);
+        while (slots[slot] != STORE_NO_PAGE) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = (uint32_t)i;
+    }
+
+    StorePageIndexHeader header;
+    memcpy(header.magic, STORE_PAGE_INDEX_MAGIC, sizeof(header.magic));
+    header.page_count = page_count;
+    header.slot_count = slot_count;
+    header.url_bytes = url_bytes;
+    snprintf(path, sizeof(path), "%s/%s", store_dir, STORE_PAGE_INDEX_FILE);
+    FILE *file = fopen(path, "wb");
+    int ok = file != NULL &&
+             fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(records, sizeof(StorePageRecord), page_count, file) == page_count &&
+             fwrite(slots, sizeof(uint32_t), slot_count, file) == slot_count;
+    for (size_t i = 0; ok && i < page_count; i++) {
+        if (page_urls[i]) {
+            size_t length = strlen(page_urls[i]) + 1;
+            ok = fwrite(page_urls[i], 1, length, file) == length;
+        }
+    }
+    if (file && fclose(file) != 0) {
+        ok = 0;
+    }
+    free(records);
+    free(slots);
+    return ok ? 0 : -1;
+}
+
+/**
+ * Writes the page lookup index, flushes and closes all store files and releases the
+ * in-memory tables. Returns 0 on success, -1 if the store could not be finalized.
+ */
+int store_close(void) {
+    int result = 0;
+    if (pages_file && write_page_index() != 0) {
+        result = -1;
+    }
+    if (segment_file) fclose(segment_file);
+    if (bodies_file) fclose(bodies_file);
+    if (pages_file) fclose(pages_file);
+    segment_file = bodies_file = pages_file = NULL;
+    free(body_slots);
+    free(body_simhashes);
+    free(simhash_known);
+    body_slots = NULL;
+    body_simhashes = NULL;
+    simhash_known = NULL;
+    simhash_capacity = 0;
+    simhash_lost = 0;
+    body_capacity = 0;
+    body_count = 0;
+    for (size_t i = 0; i < page_capacity; i++) {
+        free(page_urls[i]);
+    }
+    free(page_urls);
+    free(page_bodies);
+    page_urls = NULL;
+    page_bodies = NULL;
+    page_capacity = 0;
+    return result;
+}
@@ -0,0 +1,59 @@
+#ifndef CONTENT_STORE_H
+#define CONTENT_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fingerprint.h"
+
+// Content-addressed page store.
+// Unique bodies are appended to segment files (store/segment_N.dat) and indexed by fingerprint
+// in store/bodies.idx. Every crawled URL gets a line in store/pages.tsv pointing at its body
+// (page number, body id, fingerprint, text SimHash, truncated flag, URL), so identical pages
+// served under different URLs are written to disk only once.
+// When the store is closed, store/pages.idx is written so pages can be looked up by
+// page number or URL through a memory map (see page_reader.h).
+#define STORE_DIR "store"
+#define STORE_SEGMENT_SIZE (64L * 1024 * 1024) // Roll over to a new segment after 64 MiB
+#define STORE_BODIES_FILE "bodies.idx"
+#define STORE_PAGES_FILE "pages.tsv"
+#define STORE_PAGE_INDEX_FILE "pages.idx"
+#define STORE_PAGE_INDEX_MAGIC "WCPAGES1"
+#define STORE_NO_BODY UINT64_MAX  // Page record for a page number that was never stored
+#define STORE_NO_PAGE UINT32_MAX  // Empty slot in the URL hash table
+#define STORE_MAX_BODY_LENGTH UINT32_MAX // Longest body a body record can describe
+
+// On-disk record in bodies.idx, one per unique body (body id = record number)
+typedef struct {
+    uint64_t fp_hi;
+    uint64_t fp_lo;
+    uint64_t offset;   // Byte offset of the body inside its segment
+    uint32_t segment;  // Segment number
+    uint32_t length;   // Body length in bytes
+} StoreBodyRecord;
+
+// pages.idx layout: header, StorePageRecord[page_count] indexed by page number,
+// uint32_t url_slots[slot_count] (open-addressing table of page numbers keyed by URL hash,
+// linear probing), then the NUL-terminated URLs.
+typedef struct {
+    char magic[8];
+    uint64_t page_count; // Highest page number + 1
+    uint64_t slot_count; // Power of two
+    uint64_t url_bytes;
+} StorePageIndexHeader;
+
+typedef struct {
+    uint64_t body_id;
+    uint64_t url_offset; // Offset of the URL inside the URL area
+    uint64_t url_hash;   // url_hash() of the URL
+} StorePageRecord;
+
+int store_open(const char *dir);
+long store_claim_body(const Fingerprint *fp, int *is_new);
+int store_write_body(long body_id, const Fingerprint *fp, const char *data, size_t length);
+int store_set_body_simhash(long body_id, uint64_t simhash);
+uint64_t store_body_simhash(long body_id);
+int store_add_page(int page_index, long body_id, const Fingerprint *fp, uint64_t simhash, int truncated, const char *url);
+long store_body_count(void);
+int store_close(void);
+
+#endif
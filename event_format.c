@@ -0,0 +1,220 @@
+#include "events.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// Field layout of each event for JSON output:
+// 'u' = unsigned number, 's' = interned string id, 'F' = fingerprint (two fields, printed as hex)
+typedef struct {
+    const char *name;
+    const char *types;
+    const char *fields[6];
+} EventSchema;
+
+static const EventSchema schemas[EVENT_TYPE_COUNT] = {
+    [EVENT_TEXT] = {"text", "u", {"targets"}},
+    [EVENT_STRING] = {"string", "u", {"id"}},
+    [EVENT_FETCH_START] = {"fetch_start", "su", {"url", "depth"}},
+    [EVENT_FETCH_ATTEMPT] = {"fetch_attempt", "s", {"url"}},
+    [EVENT_PAGE_PROCESSING] = {"page_processing", "us", {"page", "url"}},
+    [EVENT_PAGE_SAVED] = {"page_saved", "uuFs", {"page", "body", "fingerprint", "url"}},
+    [EVENT_PAGE_DUPLICATE] = {"page_duplicate", "uuFs", {"page", "body", "fingerprint", "url"}},
+    [EVENT_WORD_COUNTS] = {"word_counts", "us", {"page", "url"}},
+    [EVENT_NEAR_DUPLICATE] = {"near_duplicate", "uus", {"page", "similar_page", "url"}},
+    [EVENT_LINK_EXTRACTED] = {"link_extracted", "s", {"link"}},
+    [EVENT_PAGE_DONE] = {"page_done", "s", {"url"}},
+    [EVENT_FETCH_FAILED] = {"fetch_failed", "sus", {"url", "curl_code", "error"}},
+    [EVENT_FETCH_RETRY] = {"fetch_retry", "suuuu", {"url", "curl_code", "status", "retry", "delay_ms"}},
+    [EVENT_PAGE_TRUNCATED] = {"page_truncated", "uus", {"page", "bytes", "url"}},
+    [EVENT_FETCH_SKIPPED] = {"fetch_skipped", "ss", {"url", "reason"}},
+    [EVENT_FETCH_HTTP_ERROR] = {"fetch_http_error", "su", {"url", "status"}},
+};
+
+// Bounded output buffer used by the renderers
+typedef struct {
+    char *data;
+    size_t capacity;
+    size_t length;
+} RenderBuffer;
+
+static void render(RenderBuffer *out, const char *format, ...) {
+    if (out->length + 1 >= out->capacity) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(out->data + out->length, out->capacity - out->length, format, args);
+    va_end(args);
+    if (n > 0) {
+        out->length += (size_t)n;
+        if (out->length >= out->capacity) {
+            out->length = out->capacity - 1; // Truncated
+        }
+    }
+}
+
+static void render_json_string(RenderBuffer *out, const char *s, size_t length) {
+    render(out, "\"");
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            render(out, "\\%c", c);
+        } else if (c == '\n') {
+            render(out, "\\n");
+        } else if (c < 0x20) {
+            render(out, "\\u%04x", c);
+        } else {
+            render(out, "%c", c);
+        }
+    }
+    render(out, "\"");
+}
+
+static const char *lookup_string(EventStringLookup lookup, void *context, uint64_t id) {
+    const char *s = lookup(context, id);
+    return s ? s : "?";
+}
+
+const char *event_name(int event) {
+    return event >= 0 && event < EVENT_TYPE_COUNT ? schemas[event].name : "unknown";
+}
+
+/**
+ * Returns the event type with the given name, or -1 if there is none.
+ */
+int event_lookup(const char *name) {
+    for (int i = 0; i < EVENT_TYPE_COUNT; i++) {
+        if (strcmp(schemas[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Renders an event as the text line(s) the crawler has always written to its log.
+ * Returns the number of characters written (the output is NUL-terminated and truncated to capacity).
+ */
+size_t event_render_text(const EventHeader *header, const uint64_t *fields, const char *raw,
+                         EventStringLookup lookup, void *context, char *out, size_t capacity) {
+    RenderBuffer buffer = {out, capacity, 0};
+    RenderBuffer *b = &buffer;
+    const uint64_t *f = fields;
+    if (capacity == 0) {
+        return 0;
+    }
+    out[0] = '\0';
+
+    switch (header->event) {
+    case EVENT_TEXT:
+        render(b, "%.*s", (int)header->length, raw);
+        break;
+    case EVENT_STRING:
+        break; // Definitions only
+    case EVENT_FETCH_START:
+        render(b, "Fetching URL: %s (Depth: %d)\n", lookup_string(lookup, context, f[0]), (int)f[1]);
+        break;
+    case EVENT_FETCH_ATTEMPT:
+        render(b, "Attempting to fetch URL: %s\n", lookup_string(lookup, context, f[0]));
+        break;
+    case EVENT_PAGE_PROCESSING:
+        render(b, "Processing page_%d for URL: %s\n", (int)f[0], lookup_string(lookup, context, f[1]));
+        break;
+    case EVENT_PAGE_SAVED:
+    case EVENT_PAGE_DUPLICATE:
+        render(b, header->event == EVENT_PAGE_SAVED ? "HTML content of page_%d saved as body %ld (%016llx%016llx) for URL: %s\n"
+                                                  : "Duplicate content: page_%d shares body %ld (%016llx%016llx) for URL: %s\n",
+               (int)f[0], (long)f[1], (unsigned long long)f[2], (unsigned long long)f[3], lookup_string(lookup, context, f[4]));
+        break;
+    case EVENT_WORD_COUNTS:
+        render(b, "Word counts for page_%d (URL: %s):\n", (int)f[0], lookup_string(lookup, context, f[1]));
+        for (int i = 2; i + 1 < header->field_count; i += 2) {
+            render(b, "The word '%s' appears %d times on page_%d.\n",
+                   lookup_string(lookup, context, f[i]), (int)f[i + 1], (int)f[0]);
+        }
+        render(b, "--- End of word counts for page_%d ---\n", (int)f[0]);
+        break;
+    case EVENT_NEAR_DUPLICATE:
+        render(b, "Near-duplicate: page_%d is similar to page_%d, deprioritizing its links (URL: %s)\n",
+               (int)f[0], (int)f[1], lookup_string(lookup, context, f[2]));
+        break;
+    case EVENT_LINK_EXTRACTED:
+        render(b, "Extracted Link: %s\n", lookup_string(lookup, context, f[0]));
+        break;
+    case EVENT_PAGE_DONE:
+        render(b, "Successfully processed URL: %s\n", lookup_string(lookup, context, f[0]));
+        break;
+    case EVENT_FETCH_FAILED:
+        render(b, "Failed to fetch URL: %s (%s)\n", lookup_string(lookup, context, f[0]), lookup_string(lookup, context, f[2]));
+        break;
+    case EVENT_FETCH_RETRY:
+        render(b, "Retrying URL: %s in %u ms (retry %u, curl code %u, status %u)\n", lookup_string(lookup, context, f[0]),
+               (unsigned)f[4], (unsigned)f[3], (unsigned)f[1], (unsigned)f[2]);
+        break;
+    case EVENT_PAGE_TRUNCATED:
+        render(b, "Truncated page_%d at %llu bytes (URL: %s)\n", (int)f[0], (unsigned long long)f[1],
+               lookup_string(lookup, context, f[2]));
+        break;
+    case EVENT_FETCH_SKIPPED:
+        render(b, "Skipped body of URL: %s (%s)\n", lookup_string(lookup, context, f[0]), lookup_string(lookup, context, f[1]));
+        break;
+    case EVENT_FETCH_HTTP_ERROR:
+        render(b, "Failed to fetch URL: %s (HTTP status %u)\n", lookup_string(lookup, context, f[0]), (unsigned)f[1]);
+        break;
+    default:
+        render(b, "Unknown event %u\n", (unsigned)header->event);
+        break;
+    }
+    return buffer.length;
+}
+
+/**
+ * Renders an event as one JSON object per line.
+ * Returns the number of characters written (NUL-terminated, truncated to capacity).
+ */
+size_t event_render_json(const EventHeader *header, const uint64_t *fields, const char *raw,
+                         EventStringLookup lookup, void *context, char *out, size_t capacity) {
+    RenderBuffer buffer = {out, capacity, 0};
+    RenderBuffer *b = &buffer;
+    if (capacity == 0) {
+        return 0;
+    }
+    out[0] = '\0';
+    render(b, "{\"ts\":%llu,\"thread\":%u,\"event\":\"%s\"",
+           (unsigned long long)header->timestamp, header->thread, event_name(header->event));
+
+    if (header->event < EVENT_TYPE_COUNT) {
+        const EventSchema *schema = &schemas[header->event];
+        int f = 0;
+        for (int i = 0; schema->types[i] && f < header->field_count; i++) {
+            render(b, ",\"%s\":", schema->fields[i]);
+            if (schema->types[i] == 's') {
+                const char *s = lookup_string(lookup, context, fields[f++]);
+                render_json_string(b, s, strlen(s));
+            } else if (schema->types[i] == 'F' && f + 1 < header->field_count) {
+                render(b, "\"%016llx%016llx\"", (unsigned long long)fields[f], (unsigned long long)fields[f + 1]);
+                f += 2;
+            } else {
+                render(b, "%llu", (unsigned long long)fields[f++]);
+            }
+        }
+        if (header->event == EVENT_WORD_COUNTS) {
+            render(b, ",\"words\":{");
+            for (int i = 2; i + 1 < header->field_count; i += 2) {
+                const char *word = lookup_string(lookup, context, fields[i]);
+                if (i > 2) {
+                    render(b, ",");
+                }
+                render_json_string(b, word, strlen(word));
+                render(b, ":%llu", (unsigned long long)fields[i + 1]);
+            }
+            render(b, "}");
+        }
+        if (header->event == EVENT_TEXT || header->event == EVENT_STRING) {
+            render(b, header->event == EVENT_TEXT ? ",\"text\":" : ",\"string\":");
+            render_json_string(b, raw, header->length);
+        }
+    }
+    render(b, "}\n");
+    return buffer.length;
+}
@@ -0,0 +1,57 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary structured event log.
+// Worker threads record events as an event id plus numeric fields; strings (URLs, links,
+// words, error messages) are interned once and referenced by id. The drainer appends the
+// raw records to crawler_events.bin and renders them to text for the console and log file;
+// logdecode renders the same file to text or JSON offline.
+//
+// File layout: EVENT_LOG_MAGIC, then records. Each record is an EventHeader followed by
+// field_count uint64_t fields and `length` raw bytes (only for EVENT_TEXT and EVENT_STRING).
+#define EVENT_LOG_MAGIC "WCEVLOG1"
+#define EVENT_MAX_FIELDS 32
+
+typedef enum {
+    EVENT_TEXT = 0,        // fields: targets;                raw: preformatted message
+    EVENT_STRING,          // fields: string id;              raw: the string
+    EVENT_FETCH_START,     // fields: url, depth
+    EVENT_FETCH_ATTEMPT,   // fields: url
+    EVENT_PAGE_PROCESSING, // fields: page, url
+    EVENT_PAGE_SAVED,      // fields: page, body, fingerprint hi, fingerprint lo, url
+    EVENT_PAGE_DUPLICATE,  // fields: page, body, fingerprint hi, fingerprint lo, url
+    EVENT_WORD_COUNTS,     // fields: page, url, then (word, count) pairs
+    EVENT_NEAR_DUPLICATE,  // fields: page, similar page, url
+    EVENT_LINK_EXTRACTED,  // fields: link
+    EVENT_PAGE_DONE,       // fields: url
+    EVENT_FETCH_FAILED,    // fields: url, curl code, error message
+    EVENT_FETCH_RETRY,     // fields: url, curl code, HTTP status, retry number, delay in ms
+    EVENT_PAGE_TRUNCATED,  // fields: page, bytes kept, url
+    EVENT_FETCH_SKIPPED,   // fields: url, reason
+    EVENT_FETCH_HTTP_ERROR, // fields: url, HTTP status
+    EVENT_TYPE_COUNT
+} EventType;
+
+typedef struct {
+    uint64_t timestamp;   // Monotonic time in nanoseconds
+    uint32_t thread;      // Logging thread number (order of first log call)
+    uint16_t event;       // EventType
+    uint16_t field_count;
+    uint32_t length;      // Raw bytes after the fields
+    uint32_t reserved;
+} EventHeader;
+
+// Resolves an interned string id; returns NULL if unknown
+typedef const char *(*EventStringLookup)(void *context, uint64_t id);
+
+const char *event_name(int event);
+int event_lookup(const char *name);
+size_t event_render_text(const EventHeader *header, const uint64_t *fields, const char *raw,
+                         EventStringLookup lookup, void *context, char *out, size_t capacity);
+size_t event_render_json(const EventHeader *header, const uint64_t *fields, const char *raw,
+                         EventStringLookup lookup, void *context, char *out, size_t capacity);
+
+#endif
@@ -0,0 +1,115 @@
+#include "fingerprint.h"
+#include <stdio.h>
+#include <string.h>
+
+// Streaming MurmurHash3 (x64, 128-bit variant). Produces the same value no matter
+// how the input is split into chunks.
+
+#define FP_C1 0x87c37b91114253d5ULL
+#define FP_C2 0x4cf5ad432745937fULL
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+static uint64_t load64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i]; // Little-endian load, independent of host byte order
+    }
+    return v;
+}
+
+/**
+ * Mixes one full 16-byte block into the running state.
+ */
+static void fingerprint_block(FingerprintState *state, const unsigned char *block) {
+    uint64_t k1 = load64(block);
+    uint64_t k2 = load64(block + 8);
+
+    k1 *= FP_C1; k1 = rotl64(k1, 31); k1 *= FP_C2; state->h1 ^= k1;
+    state->h1 = rotl64(state->h1, 27); state->h1 += state->h2; state->h1 = state->h1 * 5 + 0x52dce729;
+
+    k2 *= FP_C2; k2 = rotl64(k2, 33); k2 *= FP_C1; state->h2 ^= k2;
+    state->h2 = rotl64(state->h2, 31); state->h2 += state->h1; state->h2 = state->h2 * 5 + 0x38495ab5;
+}
+
+void fingerprint_init(FingerprintState *state) {
+    memset(state, 0, sizeof(*state));
+}
+
+void fingerprint_update(FingerprintState *state, const void *data, size_t length) {
+    const unsigned char *p = (const unsigned char *)data;
+    state->total_length += length;
+
+    // Complete a block left partially filled by the previous chunk
+    if (state->tail_length > 0) {
+        size_t need = 16 - state->tail_length;
+        if (length < need) {
+            memcpy(state->tail + state->tail_length, p, length);
+            state->tail_length += length;
+            return;
+        }
+        memcpy(state->tail + state->tail_length, p, need);
+        fingerprint_block(state, state->tail);
+        state->tail_length = 0;
+        p += need;
+        length -= need;
+    }
+    while (length >= 16) {
+        fingerprint_block(state, p);
+        p += 16;
+        length -= 16;
+    }
+    memcpy(state->tail, p, length);
+    state->tail_length = length;
+}
+
+Fingerprint fingerprint_final(const FingerprintState *state) {
+    uint64_t h1 = state->h1, h2 = state->h2;
+    uint64_t k1 = 0, k2 = 0;
+    const unsigned char *tail = state->tail;
+
+    for (size_t i = state->tail_length; i > 8; i--) {
+        k2 ^= (uint64_t)tail[i - 1] << ((i - 9) * 8);
+    }
+    if (state->tail_length > 8) {
+        k2 *= FP_C2; k2 = rotl64(k2, 33); k2 *= FP_C1; h2 ^= k2;
+    }
+    for (size_t i = state->tail_length < 8 ? state->tail_length : 8; i > 0; i--) {
+        k1 ^= (uint64_t)tail[i - 1] << ((i - 1) * 8);
+    }
+    if (state->tail_length > 0) {
+        k1 *= FP_C1; k1 = rotl64(k1, 31); k1 *= FP_C2; h1 ^= k1;
+    }
+
+    h1 ^= state->total_length;
+    h2 ^= state->total_length;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+
+    Fingerprint fp = {h1, h2};
+    return fp;
+}
+
+int fingerprint_equal(const Fingerprint *a, const Fingerprint *b) {
+    return a->hi == b->hi && a->lo == b->lo;
+}
+
+void fingerprint_to_hex(const Fingerprint *fp, char out[FINGERPRINT_HEX_LENGTH]) {
+    snprintf(out, FINGERPRINT_HEX_LENGTH, "%016llx%016llx",
+             (unsigned long long)fp->hi, (unsigned long long)fp->lo);
+}
@@ -0,0 +1,29 @@
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 128-bit content fingerprint of a page body
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} Fingerprint;
+
+// Streaming state so the fingerprint can be computed chunk by chunk while curl delivers data
+typedef struct {
+    uint64_t h1, h2;
+    unsigned char tail[16]; // Bytes left over from the previous chunk
+    size_t tail_length;
+    uint64_t total_length;
+} FingerprintState;
+
+#define FINGERPRINT_HEX_LENGTH 33 // 32 hex digits plus terminator
+
+void fingerprint_init(FingerprintState *state);
+void fingerprint_update(FingerprintState *state, const void *data, size_t length);
+Fingerprint fingerprint_final(const FingerprintState *state);
+int fingerprint_equal(const Fingerprint *a, const Fingerprint *b);
+void fingerprint_to_hex(const Fingerprint *fp, char out[FINGERPRINT_HEX_LENGTH]);
+
+#endif
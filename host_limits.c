@@ -0,0 +1,208 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like pthread_condattr_setclock
+#define _POSIX_C_SOURCE 200809L
+#include "host_limits.h"
+#include "lock_profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static pthread_mutex_t host_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_condattr_t host_cond_attr; // Conditions wait on the monotonic clock
+static HostState **hosts = NULL;          // Open-addressing table keyed by host name
+static size_t host_slots = 0;             // Power of two
+static size_t host_count = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Length of the host part of a URL: everything before the third slash.
+ */
+static size_t host_length(const char *url) {
+    int slashes = 0;
+    size_t i = 0;
+    for (; url[i]; i++) {
+        if (url[i] == '/' && ++slashes == 3) {
+            break;
+        }
+    }
+    return i;
+}
+
+static uint64_t hash_host(const char *name, size_t length) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/**
+ * Returns the table slot holding the host, or the empty slot where it would go.
+ */
+static size_t find_slot(const char *name, size_t length) {
+    size_t i = (size_t)hash_host(name, length) & (host_slots - 1);
+    while (hosts[i] && !(strlen(hosts[i]->name) == length && memcmp(hosts[i]->name, name, length) == 0)) {
+        i = (i + 1) & (host_slots - 1);
+    }
+    return i;
+}
+
+/**
+ * Doubles the host table. Returns 0 on success, -1 if out of memory.
+ */
+static int grow_table(void) {
+    size_t old_slots = host_slots;
+    HostState **old = hosts;
+    HostState **table = calloc(old_slots * 2, sizeof(HostState *));
+    if (!table) {
+        return -1;
+    }
+    hosts = table;
+    host_slots = old_slots * 2;
+    for (size_t i = 0; i < old_slots; i++) {
+        if (old[i]) {
+            hosts[find_slot(old[i]->name, strlen(old[i]->name))] = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+/**
+ * Returns the state of the host of `url`, adding it with the initial limits if it is
+ * new, or NULL if out of memory. Must be called with host_lock held.
+ */
+static HostState *find_host(const char *url) {
+    size_t length = host_length(url);
+    size_t slot = find_slot(url, length);
+    if (hosts[slot]) {
+        return hosts[slot];
+    }
+    if ((host_count + 1) * 2 > host_slots) {
+        if (grow_table() != 0) {
+            return NULL;
+        }
+        slot = find_slot(url, length);
+    }
+    HostState *host = calloc(1, sizeof(HostState));
+    if (!host || !(host->name = malloc(length + 1))) {
+        free(host);
+        return NULL;
+    }
+    memcpy(host->name, url, length);
+    host->name[length] = '\0';
+    host->window = HOST_INITIAL_WINDOW;
+    host->rate = HOST_INITIAL_RATE;
+    pthread_cond_init(&host->ready, &host_cond_attr);
+    hosts[slot] = host;
+    host_count++;
+    return host;
+}
+
+/**
+ * How far ahead of its due time a request may start: the burst allowance of the bucket.
+ */
+static uint64_t burst_ns(const HostState *host) {
+    return (uint64_t)((host->window - 1) * 1e9 / host->rate);
+}
+
+/**
+ * Prepares the host table. Returns 0 on success, -1 if out of memory.
+ */
+int host_limits_init(void) {
+    pthread_condattr_init(&host_cond_attr);
+    pthread_condattr_setclock(&host_cond_attr, CLOCK_MONOTONIC);
+    host_slots = 64;
+    hosts = calloc(host_slots, sizeof(HostState *));
+    return hosts ? 0 : -1;
+}
+
+/**
+ * Waits until the host of `url` may take one more request: it has a free slot in its
+ * window and the rate allows another start. Returns the host
+ * to pass to host_release, or NULL if out of memory (the request then goes ahead
+ * unthrottled).
+ */
+HostState *host_acquire(const char *url) {
+    MUTEX_LOCK_NAMED(&host_lock, "host_lock");
+    HostState *host = find_host(url);
+    if (!host) {
+        MUTEX_UNLOCK(&host_lock);
+        return NULL;
+    }
+    uint64_t now = now_ns();
+    while (1) {
+        if (host->active >= (int)host->window) {
+            COND_WAIT(&host->ready, &host_lock);
+        } else if (now + burst_ns(host) < host->next_start) {
+            uint64_t start = host->next_start - burst_ns(host);
+            struct timespec deadline = {(time_t)(start / 1000000000ULL), (long)(start % 1000000000ULL)};
+            COND_TIMEDWAIT(&host->ready, &host_lock, &deadline);
+        } else {
+            break;
+        }
+        now = now_ns();
+    }
+    host->active++;
+    host->next_start = (host->next_start > now ? host->next_start : now) + (uint64_t)(1e9 / host->rate);
+    MUTEX_UNLOCK(&host_lock);
+    return host;
+}
+
+/**
+ * Finishes a request taken with host_acquire and adjusts the host's limits from how it
+ * went: `response` classifies the outcome and `latency_us` is the total response time.
+ */
+void host_release(HostState *host, HostResponse response, uint64_t latency_us) {
+    if (!host) {
+        return;
+    }
+    uint64_t now = now_ns();
+    MUTEX_LOCK_NAMED(&host_lock, "host_lock");
+    host->active--;
+    if (latency_us > 0) {
+        if (host->latency_us == 0) {
+            host->latency_us = host->recent_us = latency_us;
+        }
+        host->recent_us += (latency_us - host->recent_us) / 4;
+    }
+    int spike = host->recent_us > host->latency_us * HOST_LATENCY_SPIKE &&
+                host->recent_us > host->latency_us + HOST_LATENCY_SLACK_US;
+    if (response == HOST_RESPONSE_OVERLOADED || spike) {
+        // Back off at most once per typical response time, so a burst of failures from
+        // requests that were in flight together counts once
+        if (now - host->last_backoff >= (uint64_t)(host->latency_us * 1000)) {
+            host->window = host->window / 2 < 1 ? 1 : host->window / 2;
+            host->rate = host->rate / 2 < HOST_MIN_RATE ? HOST_MIN_RATE : host->rate / 2;
+            host->last_backoff = now;
+        }
+    } else {
+        host->window = host->window + 1 / host->window > HOST_MAX_WINDOW ? HOST_MAX_WINDOW : host->window + 1 / host->window;
+        host->rate = host->rate + HOST_RATE_STEP > HOST_MAX_RATE ? HOST_MAX_RATE : host->rate + HOST_RATE_STEP;
+        if (latency_us > 0) {
+            // The usual latency only follows normal responses, so a slowdown stays visible
+            host->latency_us += (latency_us - host->latency_us) / 16;
+        }
+    }
+    pthread_cond_broadcast(&host->ready);
+    MUTEX_UNLOCK(&host_lock);
+}
+
+void host_limits_destroy(void) {
+    for (size_t i = 0; i < host_slots; i++) {
+        if (hosts[i]) {
+            pthread_cond_destroy(&hosts[i]->ready);
+            free(hosts[i]->name);
+            free(hosts[i]);
+        }
+    }
+    free(hosts);
+    hosts = NULL;
+    host_slots = host_count = 0;
+    pthread_condattr_destroy(&host_cond_attr);
+}
@@ -0,0 +1,47 @@
+#ifndef HOST_LIMITS_H
+#define HOST_LIMITS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+// Per-host politeness with feedback control (AIMD, as in TCP congestion control).
+// Every host (scheme, name and port of a URL) has a window of concurrent requests and a
+// request rate; requests are spaced by the rate, with bursts of up to a window's worth
+// after a quiet spell (a token bucket in GCRA form). Each response with normal latency grows the window by 1/window (one more
+// request per window's worth of responses) and the rate by a fixed step; a 429 or 503
+// response, a timeout or connection failure, or a latency spike halves both, at most
+// once per typical response time of the host. A spike is recent latency (a fast moving
+// average) well above the host's usual latency (a slow one), so single slow pages do not
+// count. Fast hosts are crawled with growing concurrency, struggling ones backed off.
+#define HOST_INITIAL_WINDOW 4
+#define HOST_MAX_WINDOW 64
+#define HOST_INITIAL_RATE 10.0      // Requests per second, until the host has answered well
+#define HOST_RATE_STEP 1.0          // Added to the rate per good response
+#define HOST_MIN_RATE 0.1
+#define HOST_MAX_RATE 1000.0
+#define HOST_LATENCY_SPIKE 2.0      // Recent latency this many times the usual is a spike
+#define HOST_LATENCY_SLACK_US 20000 // ... if it is also this much higher, to ignore jitter
+
+typedef enum {
+    HOST_RESPONSE_OK = 0,    // Answered normally (including errors like 404 that say nothing about load)
+    HOST_RESPONSE_OVERLOADED // 429/503, timeout, refused or dropped connection
+} HostResponse;
+
+typedef struct {
+    char *name;            // Scheme, host and port, e.g. "https://example.com"
+    double window;         // Concurrent requests allowed
+    int active;            // Requests in flight
+    double rate;           // Request starts per second
+    uint64_t next_start;   // When the next request is due at the current rate (monotonic ns)
+    double latency_us;     // Usual response time, a slow moving average (0 until the first response)
+    double recent_us;      // Recent response time, a fast moving average
+    uint64_t last_backoff; // When the window was last cut (monotonic ns)
+    pthread_cond_t ready;  // Signaled when a slot frees up or the limits change
+} HostState;
+
+int host_limits_init(void);
+HostState *host_acquire(const char *url);
+void host_release(HostState *host, HostResponse response, uint64_t latency_us);
+void host_limits_destroy(void);
+
+#endif
@@ -0,0 +1,189 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like strdup
+#define _POSIX_C_SOURCE 200809L
+#include "html_parse.h"
+#include "simhash.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Checks whether a character separates words (whitespace or punctuation).
+ */
+static int is_word_delimiter(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || ispunct((unsigned char)c);
+}
+
+/**
+ * Counts the occurrences of each of `words` (lowercase) in the HTML content into `counts`.
+ * The same walk over the words feeds the text outside of tags into a SimHash,
+ * which is returned as the page's near-duplicate fingerprint.
+ */
+uint64_t html_count_words(const char *html, const char *const words[], int word_count, int counts[]) {
+    memset(counts, 0, word_count * sizeof(int));
+    SimhashState simhash;
+    simhash_init(&simhash);
+
+    char token[256]; // Lowercase copy of the current word (longer words are truncated for hashing)
+    int in_tag = 0;
+    const char *p = html;
+    while (*p) {
+        if (is_word_delimiter(*p)) {
+            if (*p == '<') {
+                in_tag = 1;
+            } else if (*p == '>') {
+                in_tag = 0;
+            }
+            p++;
+            continue;
+        }
+        // Collect one word, lowercasing it to make the search case-insensitive
+        size_t length = 0, token_length = 0;
+        while (p[length] && !is_word_delimiter(p[length])) {
+            if (token_length < sizeof(token)) {
+                token[token_length++] = tolower((unsigned char)p[length]);
+            }
+            length++;
+        }
+        // A word matches only when it is not part of another word (whole token comparison)
+        for (int i = 0; i < word_count; i++) {
+            if (length == strlen(words[i]) && memcmp(token, words[i], length) == 0) {
+                counts[i]++;
+                break;
+            }
+        }
+        if (!in_tag) {
+            simhash_add_token(&simhash, token, token_length);
+        }
+        p += length;
+    }
+    return simhash_final(&simhash);
+}
+
+/**
+ * Returns a lowercased copy of the HTML content for link extraction (to be freed by the caller),
+ * or NULL if memory runs out.
+ */
+char *html_lowercase(const char *html) {
+    char *lower = strdup(html);
+    if (!lower) {
+        return NULL;
+    }
+    for (char *p = lower; *p; ++p) {
+        *p = tolower((unsigned char)*p);
+    }
+    return lower;
+}
+
+/**
+ * Finds the next link in lowercased HTML and copies its target into `link`.
+ * Links that do not fit in `capacity` bytes are skipped.
+ * Returns the position to continue searching from, or NULL when there are no more links.
+ */
+const char *html_next_link(const char *html_lower, char *link, size_t capacity) {
+    const char *start = html_lower;
+    while ((start = strstr(start, HTML_LINK_PREFIX)) != NULL) {
+        start += strlen(HTML_LINK_PREFIX);
+        const char *end = strchr(start, '"');
+        if (!end) {
+            return NULL; // Unterminated attribute: no complete link follows
+        }
+        size_t length = end - start;
+        if (length < capacity) {
+            memcpy(link, start, length);
+            link[length] = '\0';
+            return end + 1;
+        }
+        start = end + 1;
+    }
+    return NULL;
+}
+
+/**
+ * Resolves a link found on `page_url` into `out` (`capacity` bytes).
+ * Absolute links are kept as they are and classified by whether they start with the
+ * site of `start_url` (its scheme and host). Links starting with "../" are resolved
+ * against the parent directory of the page; other relative links against the site root.
+ */
+UrlResolution url_resolve(const char *start_url, const char *page_url, const char *link, char *out, size_t capacity) {
+    char base_domain[capacity];
+    char relative_base[capacity];
+    strncpy(base_domain, start_url, capacity - 1);
+    base_domain[capacity - 1] = '\0';
+
+    // Extract base domain by truncating at the third slash
+    int slash_count = 0;
+    for (char *p = base_domain; *p; ++p) {
+        if (*p == '/' && ++slash_count == 3) {
+            *p = '\0';
+            break;
+        }
+    }
+
+    // Ensure base_domain ends with a '/'
+    size_t base_len = strlen(base_domain);
+    if (base_len > 0 && base_domain[base_len - 1] != '/' && base_len + 1 < capacity) {
+        base_domain[base_len] = '/';
+        base_domain[base_len + 1] = '\0';
+    }
+
+    // Handle absolute vs relative URLs
+    if (strncmp(link, "http", 4) == 0) {
+        if (strlen(link) >= capacity) {
+            return URL_RESOLVED_TOO_LONG;
+        }
+        strcpy(out, link);
+        return strncmp(link, base_domain, strlen(base_domain)) == 0 ? URL_RESOLVED_CRAWL : URL_RESOLVED_OFFSITE;
+    }
+    if (strncmp(link, "../", 3) == 0) {
+        // Resolve ../ by removing the last two components (file and directory) of the page URL
+        strncpy(relative_base, page_url, capacity - 1);
+        relative_base[capacity - 1] = '\0';
+        for (int i = 0; i < 2; i++) {
+            char *last_slash = strrchr(relative_base, '/');
+            if (last_slash) {
+                *last_slash = '\0';
+            }
+        }
+        snprintf(out, capacity, "%s/%s", relative_base, link + 3);
+    } else {
+        snprintf(out, capacity, "%s/%s", base_domain, link);
+    }
+    return URL_RESOLVED_CRAWL;
+}
+
+// File extensions of links that never lead to an HTML page
+static const char *const skipped_extensions[] = {
+    "jpg", "jpeg", "png", "gif", "webp", "svg", "ico", "bmp", "tif", "tiff",
+    "pdf", "doc", "docx", "xls", "xlsx", "ppt", "pptx", "odt", "ods",
+    "zip", "gz", "tgz", "bz2", "xz", "tar", "rar", "7z",
+    "exe", "msi", "dmg", "iso", "apk", "bin",
+    "mp3", "mp4", "m4a", "avi", "mov", "mkv", "wav", "ogg", "flac", "webm",
+    "css", "js", "woff", "woff2", "ttf", "otf", "eot"};
+
+/**
+ * Tells whether a URL's path ends in the extension of an image, document, archive,
+ * media file, font, script or stylesheet, so it can be dropped without being fetched.
+ * Only the last path segment counts; the query and fragment are ignored.
+ */
+int url_has_skipped_extension(const char *url) {
+    size_t end = strcspn(url, "?#");
+    size_t dot = end;
+    while (dot > 0 && url[dot - 1] != '.' && url[dot - 1] != '/') {
+        dot--;
+    }
+    if (dot == 0 || url[dot - 1] != '.' || end - dot == 0 || end - dot > 5) {
+        return 0;
+    }
+    char extension[6];
+    for (size_t i = dot; i < end; i++) {
+        extension[i - dot] = (char)tolower((unsigned char)url[i]);
+    }
+    extension[end - dot] = '\0';
+    for (size_t i = 0; i < sizeof(skipped_extensions) / sizeof(skipped_extensions[0]); i++) {
+        if (strcmp(extension, skipped_extensions[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef HTML_PARSE_H
+#define HTML_PARSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Page analysis used by the crawler workers: counting important words, extracting
+// links and resolving them against the page they were found on. Nothing here locks,
+// logs or allocates shared state, so every function can be timed on its own.
+#define HTML_LINK_PREFIX "<a href=\"" // Links are only recognized in this exact (lowercased) form
+
+// How a link resolved
+typedef enum {
+    URL_RESOLVED_CRAWL,   // Same site as the start URL: crawl it
+    URL_RESOLVED_OFFSITE, // Absolute link to another site: record it, do not crawl it
+    URL_RESOLVED_TOO_LONG // Absolute link longer than the output buffer: skip it
+} UrlResolution;
+
+uint64_t html_count_words(const char *html, const char *const words[], int word_count, int counts[]);
+char *html_lowercase(const char *html);
+const char *html_next_link(const char *html_lower, char *link, size_t capacity);
+UrlResolution url_resolve(const char *start_url, const char *page_url, const char *link, char *out, size_t capacity);
+int url_has_skipped_extension(const char *url);
+
+#endif
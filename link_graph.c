@@ -0,0 +1,311 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like mmap
+#define _POSIX_C_SOURCE 200809L
+#include "link_graph.h"
+#include "lock_profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define GRAPH_PATH_LENGTH 512
+#define VARINT_MAX_BYTES 5 // Enough for any 32-bit value
+
+typedef struct {
+    uint32_t source;
+    uint32_t target;
+} GraphEdge;
+
+static FILE *edges_file = NULL;
+static char edges_path[GRAPH_PATH_LENGTH + 32];
+static pthread_mutex_t graph_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Opens the temporary edge file in `dir`. Returns 0 on success, -1 on failure.
+ */
+int graph_open(const char *dir) {
+    snprintf(edges_path, sizeof(edges_path), "%s/%s", dir, GRAPH_EDGES_FILE);
+    edges_file = fopen(edges_path, "w+b");
+    return edges_file ? 0 : -1;
+}
+
+/**
+ * Records the links of one page. All edges of a page are appended under a single lock.
+ */
+int graph_add_edges(uint32_t source, const uint32_t *targets, size_t count) {
+    GraphEdge buffer[256];
+    int result = 0;
+    MUTEX_LOCK(&graph_lock);
+    while (count > 0 && result == 0) {
+        size_t n = count < 256 ? count : 256;
+        for (size_t i = 0; i < n; i++) {
+            buffer[i].source = source;
+            buffer[i].target = targets[i];
+        }
+        if (fwrite(buffer, sizeof(GraphEdge), n, edges_file) != n) {
+            result = -1;
+        }
+        targets += n;
+        count -= n;
+    }
+    MUTEX_UNLOCK(&graph_lock);
+    return result;
+}
+
+static size_t varint_encode(uint32_t value, unsigned char *out) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char)value;
+    return n;
+}
+
+static uint32_t varint_decode(const unsigned char **pos) {
+    const unsigned char *p = *pos;
+    uint32_t value = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+        value |= (uint32_t)(*p++ & 0x7f) << shift;
+        shift += 7;
+    }
+    value |= (uint32_t)(*p++) << shift;
+    *pos = p;
+    return value;
+}
+
+static int compare_ids(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Writes the URL dictionary (id -> URL string) used to interpret node ids.
+ */
+static int write_url_dictionary(const char *path, UrlTable *urls, uint32_t count) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return -1;
+    }
+    UrlDictHeader header;
+    memcpy(header.magic, URL_DICT_MAGIC, sizeof(header.magic));
+    header.url_count = count;
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    uint64_t offset = 0;
+    for (uint32_t i = 0; ok && i <= count; i++) {
+        ok = fwrite(&offset, sizeof(offset), 1, file) == 1;
+        if (i < count) {
+            offset += strlen(url_table_get(urls, i)) + 1;
+        }
+    }
+    for (uint32_t i = 0; ok && i < count; i++) {
+        const char *url = url_table_get(urls, i);
+        ok = fwrite(url, 1, strlen(url) + 1, file) == strlen(url) + 1;
+    }
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    return ok ? 0 : -1;
+}
+
+/**
+ * Compacts the recorded edges into graph.csr and writes graph.urls. Edges are bucketed by
+ * source with a counting pass, each row is sorted and de-duplicated, and targets are stored
+ * as varint deltas. The temporary edge file is removed afterwards.
+ * Returns 0 on success, -1 on failure; *edge_count receives the number of distinct edges.
+ */
+int graph_build(const char *dir, UrlTable *urls, uint64_t *edge_count) {
+    char path[GRAPH_PATH_LENGTH + 32];
+    uint32_t node_count = url_table_count(urls);
+    uint64_t *row_start = NULL;
+    uint64_t *row_offsets = NULL;
+    uint32_t *targets = NULL;
+    FILE *out = NULL;
+    int result = -1;
+
+    MUTEX_LOCK(&graph_lock);
+    if (!edges_file || fflush(edges_file) != 0) {
+        goto done;
+    }
+    long file_size;
+    if (fseek(edges_file, 0, SEEK_END) != 0 || (file_size = ftell(edges_file)) < 0) {
+        goto done;
+    }
+    uint64_t raw_edges = (uint64_t)file_size / sizeof(GraphEdge);
+
+    // Pass 1: count the edges of every source row
+    row_start = calloc((size_t)node_count + 1, sizeof(uint64_t));
+    row_offsets = malloc(((size_t)node_count + 1) * sizeof(uint64_t));
+    targets = malloc((raw_edges ? raw_edges : 1) * sizeof(uint32_t));
+    if (!row_start || !row_offsets || !targets) {
+        goto done;
+    }
+    GraphEdge buffer[4096];
+    size_t n;
+    rewind(edges_file);
+    while ((n = fread(buffer, sizeof(GraphEdge), 4096, edges_file)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            row_start[buffer[i].source + 1]++;
+        }
+    }
+    for (uint32_t i = 0; i < node_count; i++) {
+        row_start[i + 1] += row_start[i];
+    }
+
+    // Pass 2: place every target in its row (row_offsets doubles as the fill cursor)
+    memcpy(row_offsets, row_start, ((size_t)node_count + 1) * sizeof(uint64_t));
+    rewind(edges_file);
+    while ((n = fread(buffer, sizeof(GraphEdge), 4096, edges_file)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            targets[row_offsets[buffer[i].source]++] = buffer[i].target;
+        }
+    }
+
+    // Encode rows; the offsets table is written once all row sizes are known
+    snprintf(path, sizeof(path), "%s/%s", dir, GRAPH_CSR_FILE);
+    out = fopen(path, "wb");
+    if (!out) {
+        goto done;
+    }
+    GraphHeader header;
+    memset(&header, 0, sizeof(header));
+    long adjacency_start = (long)(sizeof(header) + ((size_t)node_count + 1) * sizeof(uint64_t));
+    if (fseek(out, adjacency_start, SEEK_SET) != 0) {
+        goto done;
+    }
+    uint64_t bytes = 0, edges = 0;
+    unsigned char encoded[2 * VARINT_MAX_BYTES];
+    for (uint32_t row = 0; row < node_count; row++) {
+        uint32_t *first = targets + row_start[row];
+        size_t length = (size_t)(row_start[row + 1] - row_start[row]);
+        qsort(first, length, sizeof(uint32_t), compare_ids);
+        size_t unique = 0;
+        for (size_t i = 0; i < length; i++) {
+            if (unique == 0 || first[i] != first[unique - 1]) {
+                first[unique++] = first[i];
+            }
+        }
+        row_offsets[row] = bytes;
+        size_t k = varint_encode((uint32_t)unique, encoded);
+        uint32_t previous = 0;
+        for (size_t i = 0; i <= unique; i++) {
+            if (fwrite(encoded, 1, k, out) != k) {
+                goto done;
+            }
+            bytes += k;
+            if (i < unique) {
+                k = varint_encode(first[i] - previous, encoded);
+                previous = first[i];
+            }
+        }
+        edges += unique;
+    }
+    row_offsets[node_count] = bytes;
+
+    memcpy(header.magic, GRAPH_MAGIC, sizeof(header.magic));
+    header.node_count = node_count;
+    header.edge_count = edges;
+    header.adjacency_bytes = bytes;
+    rewind(out);
+    if (fwrite(&header, sizeof(header), 1, out) != 1 ||
+        fwrite(row_offsets, sizeof(uint64_t), (size_t)node_count + 1, out) != (size_t)node_count + 1) {
+        goto done;
+    }
+    int closed = fclose(out);
+    out = NULL;
+    if (closed != 0) {
+        goto done;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", dir, GRAPH_URLS_FILE);
+    if (write_url_dictionary(path, urls, node_count) != 0) {
+        goto done;
+    }
+    *edge_count = edges;
+    result = 0;
+
+done:
+    if (out) {
+        fclose(out);
+    }
+    if (edges_file) {
+        fclose(edges_file);
+        edges_file = NULL;
+        remove(edges_path);
+    }
+    MUTEX_UNLOCK(&graph_lock);
+    free(row_start);
+    free(row_offsets);
+    free(targets);
+    return result;
+}
+
+/**
+ * Maps a graph.csr file read-only. Returns 0 on success, -1 if the file cannot be
+ * opened or is not a valid graph file.
+ */
+int graph_map(const char *path, LinkGraph *graph) {
+    memset(graph, 0, sizeof(*graph));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GraphHeader)) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    const GraphHeader *header = map;
+    size_t expected = sizeof(GraphHeader) + (header->node_count + 1) * sizeof(uint64_t) + header->adjacency_bytes;
+    if (memcmp(header->magic, GRAPH_MAGIC, sizeof(header->magic)) != 0 || expected != (size_t)st.st_size) {
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+    graph->map = map;
+    graph->map_length = (size_t)st.st_size;
+    graph->node_count = header->node_count;
+    graph->edge_count = header->edge_count;
+    graph->row_offsets = (const uint64_t *)(header + 1);
+    graph->adjacency = (const unsigned char *)(graph->row_offsets + header->node_count + 1);
+    return 0;
+}
+
+/**
+ * Positions an iterator at the start of a row. Returns the row's out-degree.
+ */
+uint32_t graph_row_begin(const LinkGraph *graph, uint32_t node, GraphRowIterator *it) {
+    it->pos = graph->adjacency + graph->row_offsets[node];
+    it->remaining = varint_decode(&it->pos);
+    it->current = 0;
+    return it->remaining;
+}
+
+/**
+ * Fetches the next target of the row. Returns 1 while targets remain, 0 at the end of the row.
+ */
+int graph_row_next(GraphRowIterator *it, uint32_t *target) {
+    if (it->remaining == 0) {
+        return 0;
+    }
+    it->current += varint_decode(&it->pos);
+    it->remaining--;
+    *target = it->current;
+    return 1;
+}
+
+void graph_unmap(LinkGraph *graph) {
+    if (graph->map) {
+        munmap(graph->map, graph->map_length);
+    }
+    memset(graph, 0, sizeof(*graph));
+}
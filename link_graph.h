@@ -0,0 +1,61 @@
+#ifndef LINK_GRAPH_H
+#define LINK_GRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "url_table.h"
+
+// Link graph between crawled pages and the URLs they link to.
+// During the crawl, edges (source URL id, target URL id) are appended to a temporary file.
+// At crawl end they are compacted into a compressed sparse row file (store/graph.csr) and the
+// URL dictionary is written next to it (store/graph.urls). Both files are memory-mappable.
+//
+// graph.csr:  GraphHeader, uint64_t row_offsets[node_count + 1], adjacency bytes.
+//             Row i starts at adjacency + row_offsets[i] with varint(out-degree), then the
+//             sorted, de-duplicated target ids as varint(first id) and varint deltas.
+// graph.urls: UrlDictHeader, uint64_t string_offsets[url_count + 1], NUL-terminated URLs.
+#define GRAPH_EDGES_FILE "edges.tmp"
+#define GRAPH_CSR_FILE "graph.csr"
+#define GRAPH_URLS_FILE "graph.urls"
+#define GRAPH_MAGIC "WCGRAPH1"
+#define URL_DICT_MAGIC "WCURLS01"
+
+typedef struct {
+    char magic[8];
+    uint64_t node_count;
+    uint64_t edge_count;
+    uint64_t adjacency_bytes;
+} GraphHeader;
+
+typedef struct {
+    char magic[8];
+    uint64_t url_count;
+} UrlDictHeader;
+
+// Read-only view of a mapped graph.csr
+typedef struct {
+    void *map;
+    size_t map_length;
+    uint64_t node_count;
+    uint64_t edge_count;
+    const uint64_t *row_offsets;
+    const unsigned char *adjacency;
+} LinkGraph;
+
+// Cursor over the targets of one row
+typedef struct {
+    const unsigned char *pos;
+    uint32_t remaining;
+    uint32_t current;
+} GraphRowIterator;
+
+int graph_open(const char *dir);
+int graph_add_edges(uint32_t source, const uint32_t *targets, size_t count);
+int graph_build(const char *dir, UrlTable *urls, uint64_t *edge_count);
+
+int graph_map(const char *path, LinkGraph *graph);
+uint32_t graph_row_begin(const LinkGraph *graph, uint32_t node, GraphRowIterator *it);
+int graph_row_next(GraphRowIterator *it, uint32_t *target);
+void graph_unmap(LinkGraph *graph);
+
+#endif
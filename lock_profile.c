@@ -0,0 +1,175 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like clock_gettime
+#define _POSIX_C_SOURCE 200809L
+#include "lock_profile.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Counters of one lock. The counters are only updated by the thread holding the lock,
+// so they never race with each other; they are atomic so the report can read them.
+typedef struct {
+    _Atomic(pthread_mutex_t *) mutex; // NULL = free slot
+    const char *name;
+    _Atomic uint64_t acquisitions;
+    _Atomic uint64_t contended;   // Acquisitions that had to wait for another thread
+    _Atomic uint64_t wait_ns;
+    _Atomic uint64_t max_wait_ns;
+    _Atomic uint64_t hold_ns;
+    uint64_t acquired_at;         // When the current holder got the lock
+} LockStats;
+
+static LockStats locks[LOCK_PROFILE_MAX_LOCKS];
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static void add(_Atomic uint64_t *counter, uint64_t amount) {
+    atomic_fetch_add_explicit(counter, amount, memory_order_relaxed);
+}
+
+/**
+ * Returns the stats slot of a mutex, claiming a free one on first use.
+ * Returns NULL once every slot is taken.
+ */
+static LockStats *find_lock(pthread_mutex_t *mutex, const char *name) {
+    size_t start = (size_t)(((uintptr_t)mutex >> 4) * 0x9E3779B97F4A7C15ULL >> 58) % LOCK_PROFILE_MAX_LOCKS;
+    for (size_t probe = 0; probe < LOCK_PROFILE_MAX_LOCKS; probe++) {
+        LockStats *stats = &locks[(start + probe) % LOCK_PROFILE_MAX_LOCKS];
+        pthread_mutex_t *owner = atomic_load_explicit(&stats->mutex, memory_order_acquire);
+        if (owner == mutex) {
+            return stats;
+        }
+        if (!owner) {
+            if (atomic_compare_exchange_strong(&stats->mutex, &owner, mutex)) {
+                stats->name = name;
+                return stats;
+            }
+            if (owner == mutex) {
+                return stats; // Another thread registered the same mutex first
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Locks a mutex, counting whether it was contended and how long the wait took.
+ */
+int lock_profile_lock(pthread_mutex_t *mutex, const char *name) {
+    LockStats *stats = find_lock(mutex, name);
+    if (!stats) {
+        return pthread_mutex_lock(mutex);
+    }
+    uint64_t start = now_ns();
+    int result = pthread_mutex_trylock(mutex);
+    int contended = result != 0;
+    if (contended) {
+        result = pthread_mutex_lock(mutex);
+        if (result != 0) {
+            return result;
+        }
+    }
+    uint64_t acquired = now_ns();
+    add(&stats->acquisitions, 1);
+    if (contended) {
+        uint64_t wait = acquired - start;
+        add(&stats->contended, 1);
+        add(&stats->wait_ns, wait);
+        if (wait > atomic_load_explicit(&stats->max_wait_ns, memory_order_relaxed)) {
+            atomic_store_explicit(&stats->max_wait_ns, wait, memory_order_relaxed);
+        }
+    }
+    stats->acquired_at = acquired;
+    return 0;
+}
+
+/**
+ * Unlocks a mutex, adding the time since it was acquired to its hold time.
+ */
+int lock_profile_unlock(pthread_mutex_t *mutex) {
+    LockStats *stats = find_lock(mutex, NULL);
+    if (stats) {
+        add(&stats->hold_ns, now_ns() - stats->acquired_at);
+    }
+    return pthread_mutex_unlock(mutex);
+}
+
+/**
+ * Waits on a condition variable. The time spent waiting is not counted as holding the mutex.
+ */
+int lock_profile_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const char *name) {
+    LockStats *stats = find_lock(mutex, name);
+    if (stats) {
+        add(&stats->hold_ns, now_ns() - stats->acquired_at);
+    }
+    int result = pthread_cond_wait(cond, mutex);
+    if (stats) {
+        stats->acquired_at = now_ns();
+    }
+    return result;
+}
+
+int lock_profile_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *deadline,
+                                const char *name) {
+    LockStats *stats = find_lock(mutex, name);
+    if (stats) {
+        add(&stats->hold_ns, now_ns() - stats->acquired_at);
+    }
+    int result = pthread_cond_timedwait(cond, mutex, deadline);
+    if (stats) {
+        stats->acquired_at = now_ns();
+    }
+    return result;
+}
+
+static int compare_wait(const void *a, const void *b) {
+    uint64_t wait_a = atomic_load(&(*(LockStats *const *)a)->wait_ns);
+    uint64_t wait_b = atomic_load(&(*(LockStats *const *)b)->wait_ns);
+    return wait_a < wait_b ? 1 : wait_a > wait_b ? -1 : 0;
+}
+
+/**
+ * Formats a table of every profiled lock, most total wait time first.
+ * Returns the number of characters written (the report is truncated to `capacity`).
+ */
+int lock_profile_report(char *out, size_t capacity) {
+    LockStats *sorted[LOCK_PROFILE_MAX_LOCKS];
+    size_t count = 0;
+    for (size_t i = 0; i < LOCK_PROFILE_MAX_LOCKS; i++) {
+        if (atomic_load(&locks[i].mutex) && atomic_load(&locks[i].acquisitions) > 0) {
+            sorted[count++] = &locks[i];
+        }
+    }
+    qsort(sorted, count, sizeof(sorted[0]), compare_wait);
+
+    size_t length = 0;
+#define APPEND(...)                                                          \
+    do {                                                                     \
+        if (length < capacity) {                                             \
+            int n = snprintf(out + length, capacity - length, __VA_ARGS__);  \
+            length += n > 0 ? (size_t)n : 0;                                 \
+        }                                                                    \
+    } while (0)
+    APPEND("Lock profile (ranked by total wait time):\n");
+    APPEND("%-44s %12s %10s %12s %12s %12s %12s %12s\n", "lock", "acquisitions", "contended",
+           "wait ms", "avg wait us", "max wait us", "hold ms", "avg hold us");
+    for (size_t i = 0; i < count; i++) {
+        const LockStats *stats = sorted[i];
+        uint64_t acquisitions = atomic_load(&stats->acquisitions);
+        uint64_t contended = atomic_load(&stats->contended);
+        uint64_t wait = atomic_load(&stats->wait_ns);
+        uint64_t hold = atomic_load(&stats->hold_ns);
+        APPEND("%-44s %12llu %9.1f%% %12.3f %12.1f %12.1f %12.3f %12.1f\n", stats->name ? stats->name : "?",
+               (unsigned long long)acquisitions, 100.0 * contended / acquisitions, wait / 1e6,
+               contended ? wait / 1e3 / contended : 0.0, atomic_load(&stats->max_wait_ns) / 1e3,
+               hold / 1e6, hold / 1e3 / acquisitions);
+    }
+#undef APPEND
+    return (int)(length < capacity ? length : capacity - 1);
+}
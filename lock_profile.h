@@ -0,0 +1,40 @@
+#ifndef LOCK_PROFILE_H
+#define LOCK_PROFILE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+// Mutex contention profiler, compiled in with -DLOCK_PROFILE (make LOCK_PROFILE=1).
+// MUTEX_LOCK, MUTEX_UNLOCK and COND_WAIT replace the pthread calls on the crawler's
+// locks. When profiling, every lock is identified by its address and named after the
+// expression used to lock it (or an explicit name); acquisitions, contended acquisitions,
+// wait time and hold time are counted per lock. Without LOCK_PROFILE the macros are the
+// plain pthread calls.
+#ifdef LOCK_PROFILE
+
+#define LOCK_PROFILE_MAX_LOCKS 64 // Locks beyond this many are not profiled
+
+#define MUTEX_LOCK(m) lock_profile_lock((m), __FILE__ ": " #m)
+#define MUTEX_LOCK_NAMED(m, name) lock_profile_lock((m), (name))
+#define MUTEX_UNLOCK(m) lock_profile_unlock(m)
+#define COND_WAIT(c, m) lock_profile_cond_wait((c), (m), __FILE__ ": " #m)
+#define COND_TIMEDWAIT(c, m, t) lock_profile_cond_timedwait((c), (m), (t), __FILE__ ": " #m)
+
+int lock_profile_lock(pthread_mutex_t *mutex, const char *name);
+int lock_profile_unlock(pthread_mutex_t *mutex);
+int lock_profile_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const char *name);
+int lock_profile_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *deadline,
+                                const char *name);
+int lock_profile_report(char *out, size_t capacity);
+
+#else
+
+#define MUTEX_LOCK(m) pthread_mutex_lock(m)
+#define MUTEX_LOCK_NAMED(m, name) pthread_mutex_lock(m)
+#define MUTEX_UNLOCK(m) pthread_mutex_unlock(m)
+#define COND_WAIT(c, m) pthread_cond_wait((c), (m))
+#define COND_TIMEDWAIT(c, m, t) pthread_cond_timedwait((c), (m), (t))
+
+#endif
+
+#endif
@@ -0,0 +1,468 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like nanosleep
+#define _POSIX_C_SOURCE 200809L
+#include "log.h"
+#include "events.h"
+#include "url_table.h"
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define LOG_RENDER_MAX 65536 // Largest text rendering of a single event
+
+// Ring buffer owned by one producer thread and read by the drainer.
+// Records are an EventHeader, its fields and its raw bytes.
+// head and tail count bytes ever written/consumed; positions are taken modulo LOG_RING_SIZE.
+typedef struct LogRing {
+    char data[LOG_RING_SIZE];
+    atomic_size_t head;
+    atomic_size_t tail;
+    uint32_t thread;      // Thread number written into every record
+    struct LogRing *next; // Next ring in the registry
+} LogRing;
+
+// Output collected by the drainer before it is written out
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} LogOutput;
+
+// Output streams of the drainer
+enum { OUT_STDOUT, OUT_STDERR, OUT_FILE, OUT_EVENTS, OUT_COUNT };
+
+static _Atomic(LogRing *) rings = NULL; // Registry of all thread rings (push-only list)
+static _Thread_local LogRing *thread_ring = NULL;
+static atomic_uint thread_count = 0;
+static atomic_int running = 0;
+static _Thread_local uint32_t sample_counters[EVENT_TYPE_COUNT];
+static const char *level_names[LOG_LEVEL_COUNT] = {"error", "warn", "info", "debug", "trace"};
+
+int log_level = LOG_DEFAULT_LEVEL;
+uint32_t log_sample_rate[EVENT_TYPE_COUNT];
+static FILE *log_file = NULL;
+static FILE *event_file = NULL;
+static UrlTable strings;     // Interned strings referenced by events
+static int strings_ready = 0;
+static pthread_t drainer;
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER; // Only guards the drainer's sleep
+static pthread_cond_t drain_cond = PTHREAD_COND_INITIALIZER;
+
+static const char *lookup_interned(void *context, uint64_t id) {
+    (void)context;
+    return url_table_get(&strings, (uint32_t)id);
+}
+
+/**
+ * Writes a message straight to its targets. Used before the drainer starts and after it stops.
+ */
+static void write_direct(int targets, const char *text, size_t length) {
+    if (targets & LOG_TO_STDOUT) fwrite(text, 1, length, stdout);
+    if (targets & LOG_TO_STDERR) fwrite(text, 1, length, stderr);
+    if ((targets & LOG_TO_FILE) && log_file) {
+        fwrite(text, 1, length, log_file);
+        fflush(log_file);
+    }
+}
+
+/**
+ * Returns the calling thread's ring, creating and registering it on first use.
+ */
+static LogRing *get_ring(void) {
+    if (thread_ring) {
+        return thread_ring;
+    }
+    LogRing *ring = malloc(sizeof(LogRing));
+    if (!ring) {
+        return NULL;
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->thread = atomic_fetch_add(&thread_count, 1);
+    ring->next = atomic_load(&rings);
+    while (!atomic_compare_exchange_weak(&rings, &ring->next, ring)) {
+        // ring->next was refreshed with the current list head; retry
+    }
+    thread_ring = ring;
+    return ring;
+}
+
+/**
+ * Copies bytes into the ring at a logical position, wrapping around the end.
+ */
+static void ring_copy_in(LogRing *ring, size_t position, const void *src, size_t length) {
+    size_t offset = position & (LOG_RING_SIZE - 1);
+    size_t first = LOG_RING_SIZE - offset < length ? LOG_RING_SIZE - offset : length;
+    memcpy(ring->data + offset, src, first);
+    memcpy(ring->data, (const char *)src + first, length - first);
+}
+
+static void ring_copy_out(const LogRing *ring, size_t position, void *dst, size_t length) {
+    size_t offset = position & (LOG_RING_SIZE - 1);
+    size_t first = LOG_RING_SIZE - offset < length ? LOG_RING_SIZE - offset : length;
+    memcpy(dst, ring->data + offset, first);
+    memcpy((char *)dst + first, ring->data, length - first);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Appends one record to the calling thread's ring. Never blocks on a lock;
+ * if the ring is full the thread waits briefly for the drainer to catch up.
+ */
+static void ring_write(int event, int field_count, const uint64_t *fields, const char *raw, size_t length) {
+    LogRing *ring = get_ring();
+    if (!ring) {
+        return;
+    }
+    if (length > LOG_RING_SIZE / 4) {
+        length = LOG_RING_SIZE / 4; // Keep pathological messages from filling the whole ring
+    }
+    EventHeader header;
+    header.timestamp = now_ns();
+    header.thread = ring->thread;
+    header.event = (uint16_t)event;
+    header.field_count = (uint16_t)field_count;
+    header.length = (uint32_t)length;
+    header.reserved = 0;
+    size_t field_bytes = (size_t)field_count * sizeof(uint64_t);
+    size_t needed = sizeof(header) + field_bytes + length;
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    while (LOG_RING_SIZE - (head - atomic_load_explicit(&ring->tail, memory_order_acquire)) < needed) {
+        pthread_cond_signal(&drain_cond);
+        struct timespec ts = {0, 50000};
+        nanosleep(&ts, NULL);
+    }
+    ring_copy_in(ring, head, &header, sizeof(header));
+    ring_copy_in(ring, head + sizeof(header), fields, field_bytes);
+    ring_copy_in(ring, head + sizeof(header) + field_bytes, raw, length);
+    atomic_store_explicit(&ring->head, head + needed, memory_order_release);
+}
+
+/**
+ * Formats a message and logs it to the given targets (LOG_TO_* flags).
+ * Meant for rare messages; hot paths use log_event.
+ */
+void log_message(int targets, const char *format, ...) {
+    char line[LOG_LINE_MAX];
+    char *text = line;
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+    if ((size_t)length >= sizeof(line)) {
+        text = malloc((size_t)length + 1);
+        if (!text) {
+            text = line;
+            length = sizeof(line) - 1;
+        } else {
+            va_start(args, format);
+            vsnprintf(text, (size_t)length + 1, format, args);
+            va_end(args);
+        }
+    }
+    if (atomic_load_explicit(&running, memory_order_acquire)) {
+        uint64_t field = (uint64_t)targets;
+        ring_write(EVENT_TEXT, 1, &field, text, (size_t)length);
+    } else {
+        write_direct(targets, text, (size_t)length);
+    }
+    if (text != line) {
+        free(text);
+    }
+}
+
+/**
+ * Interns a string for use as an event field. The first time a string is seen its
+ * definition is written to the event log. Returns the string id (0 if it could not be interned).
+ */
+uint64_t log_string(const char *s) {
+    if (!strings_ready) {
+        return 0;
+    }
+    int is_new = 0;
+    uint32_t id = url_table_insert(&strings, s, &is_new);
+    if (id == URL_ID_NONE) {
+        return 0;
+    }
+    if (is_new && atomic_load_explicit(&running, memory_order_acquire)) {
+        uint64_t field = id;
+        ring_write(EVENT_STRING, 1, &field, s, strlen(s));
+    }
+    return id;
+}
+
+/**
+ * Records a structured event. Only the fields are copied; rendering to text happens in the drainer.
+ */
+void log_event(int event, int field_count, const uint64_t *fields) {
+    if (field_count > EVENT_MAX_FIELDS) {
+        field_count = EVENT_MAX_FIELDS;
+    }
+    if (atomic_load_explicit(&running, memory_order_acquire)) {
+        ring_write(event, field_count, fields, NULL, 0);
+        return;
+    }
+    char text[LOG_LINE_MAX];
+    EventHeader header = {now_ns(), 0, (uint16_t)event, (uint16_t)field_count, 0, 0};
+    size_t length = event_render_text(&header, fields, NULL, lookup_interned, NULL, text, sizeof(text));
+    write_direct(LOG_TO_CONSOLE_AND_FILE, text, length);
+}
+
+/**
+ * Decides whether the calling thread logs this occurrence of a sampled event.
+ * Every log_sample_rate[event]-th occurrence per thread is kept, starting with the first.
+ */
+int log_sample(int event) {
+    if (log_sample_rate[event] == LOG_SAMPLE_OFF) {
+        return 0;
+    }
+    return sample_counters[event]++ % log_sample_rate[event] == 0;
+}
+
+/**
+ * Selects the highest level that is logged by name (error, warn, info, debug, trace).
+ * Returns 0 on success, -1 if the name is unknown.
+ */
+int log_set_level(const char *name) {
+    for (int i = 0; i < LOG_LEVEL_COUNT; i++) {
+        if (strcmp(level_names[i], name) == 0) {
+            log_level = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Sets the sampling rate of one event type from a "name=N" spec, e.g. "link_extracted=100"
+ * logs one extracted link in a hundred. N = 0 turns the event off entirely.
+ * Returns 0 on success, -1 if the spec is malformed or the event is unknown.
+ */
+int log_set_sampling(const char *spec) {
+    const char *equals = strchr(spec, '=');
+    if (!equals || equals == spec || equals - spec >= 64) {
+        return -1;
+    }
+    char name[64];
+    memcpy(name, spec, (size_t)(equals - spec));
+    name[equals - spec] = '\0';
+    int event = event_lookup(name);
+    char *end;
+    unsigned long rate = strtoul(equals + 1, &end, 10);
+    if (event < 0 || event == EVENT_TEXT || event == EVENT_STRING || *end != '\0' || end == equals + 1 ||
+        rate >= LOG_SAMPLE_OFF) {
+        return -1;
+    }
+    log_sample_rate[event] = rate == 0 ? LOG_SAMPLE_OFF : (uint32_t)rate;
+    return 0;
+}
+
+static void output_append(LogOutput *out, const void *data, size_t length) {
+    if (out->length + length > out->capacity) {
+        size_t new_capacity = out->capacity ? out->capacity : 65536;
+        while (new_capacity < out->length + length) {
+            new_capacity *= 2;
+        }
+        char *grown = realloc(out->data, new_capacity);
+        if (!grown) {
+            return; // Drop the output rather than stall logging
+        }
+        out->data = grown;
+        out->capacity = new_capacity;
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+/**
+ * Routes one drained record: the raw record goes to the event file, text messages go to
+ * their targets and structured events are rendered to text for the console and log file.
+ */
+static void dispatch_record(LogOutput outputs[OUT_COUNT], const EventHeader *header,
+                            const char *payload, char *rendered) {
+    uint64_t fields[EVENT_MAX_FIELDS] = {0};
+    size_t field_bytes = (size_t)header->field_count * sizeof(uint64_t);
+    memcpy(fields, payload, field_bytes);
+    const char *raw = payload + field_bytes;
+
+    if (event_file) {
+        output_append(&outputs[OUT_EVENTS], header, sizeof(*header));
+        output_append(&outputs[OUT_EVENTS], payload, field_bytes + header->length);
+    }
+    if (header->event == EVENT_TEXT) {
+        int targets = (int)fields[0];
+        if (targets & LOG_TO_STDOUT) output_append(&outputs[OUT_STDOUT], raw, header->length);
+        if (targets & LOG_TO_STDERR) output_append(&outputs[OUT_STDERR], raw, header->length);
+        if (targets & LOG_TO_FILE) output_append(&outputs[OUT_FILE], raw, header->length);
+    } else if (header->event != EVENT_STRING) {
+        size_t length = event_render_text(header, fields, raw, lookup_interned, NULL, rendered, LOG_RENDER_MAX);
+        output_append(&outputs[OUT_STDOUT], rendered, length);
+        output_append(&outputs[OUT_FILE], rendered, length);
+    }
+}
+
+/**
+ * Moves everything currently in the rings into the output buffers, merging the rings
+ * by timestamp so lines come out in the order they were logged, and writes them out.
+ * Returns the number of bytes drained.
+ */
+static size_t drain_once(LogOutput outputs[OUT_COUNT], char *scratch, char *rendered) {
+    // Snapshot every ring's readable range
+    size_t ring_count = 0;
+    for (LogRing *ring = atomic_load(&rings); ring; ring = ring->next) {
+        ring_count++;
+    }
+    LogRing **list = malloc((ring_count ? ring_count : 1) * sizeof(LogRing *));
+    size_t *cursor = malloc((ring_count ? ring_count : 1) * sizeof(size_t));
+    size_t *limit = malloc((ring_count ? ring_count : 1) * sizeof(size_t));
+    EventHeader *next = malloc((ring_count ? ring_count : 1) * sizeof(EventHeader));
+    if (!list || !cursor || !limit || !next) {
+        free(list);
+        free(cursor);
+        free(limit);
+        free(next);
+        return 0;
+    }
+    size_t i = 0;
+    for (LogRing *ring = atomic_load(&rings); ring && i < ring_count; ring = ring->next, i++) {
+        list[i] = ring;
+        cursor[i] = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        limit[i] = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (cursor[i] < limit[i]) {
+            ring_copy_out(ring, cursor[i], &next[i], sizeof(EventHeader));
+        }
+    }
+
+    // Repeatedly take the oldest pending record
+    size_t drained = 0;
+    while (1) {
+        size_t oldest = ring_count;
+        for (i = 0; i < ring_count; i++) {
+            if (cursor[i] < limit[i] && (oldest == ring_count || next[i].timestamp < next[oldest].timestamp)) {
+                oldest = i;
+            }
+        }
+        if (oldest == ring_count) {
+            break;
+        }
+        const EventHeader *header = &next[oldest];
+        size_t payload = (size_t)header->field_count * sizeof(uint64_t) + header->length;
+        ring_copy_out(list[oldest], cursor[oldest] + sizeof(EventHeader), scratch, payload);
+        dispatch_record(outputs, header, scratch, rendered);
+        cursor[oldest] += sizeof(EventHeader) + payload;
+        drained += sizeof(EventHeader) + payload;
+        if (cursor[oldest] < limit[oldest]) {
+            ring_copy_out(list[oldest], cursor[oldest], &next[oldest], sizeof(EventHeader));
+        }
+    }
+    for (i = 0; i < ring_count; i++) {
+        atomic_store_explicit(&list[i]->tail, cursor[i], memory_order_release);
+    }
+    free(list);
+    free(cursor);
+    free(limit);
+    free(next);
+
+    FILE *streams[OUT_COUNT] = {stdout, stderr, log_file, event_file};
+    for (int k = 0; k < OUT_COUNT; k++) {
+        if (outputs[k].length > 0 && streams[k]) {
+            fwrite(outputs[k].data, 1, outputs[k].length, streams[k]);
+            fflush(streams[k]);
+        }
+        outputs[k].length = 0;
+    }
+    return drained;
+}
+
+/**
+ * Drainer thread: empties the rings whenever woken and at least every LOG_DRAIN_INTERVAL_MS.
+ */
+static void *drain_rings(void *arg) {
+    (void)arg;
+    LogOutput outputs[OUT_COUNT];
+    memset(outputs, 0, sizeof(outputs));
+    char *scratch = malloc(LOG_RING_SIZE / 2);
+    char *rendered = malloc(LOG_RENDER_MAX);
+    if (!scratch || !rendered) {
+        free(scratch);
+        free(rendered);
+        return NULL;
+    }
+    while (atomic_load_explicit(&running, memory_order_acquire)) {
+        if (drain_once(outputs, scratch, rendered) == 0) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += LOG_DRAIN_INTERVAL_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_mutex_lock(&drain_lock);
+            pthread_cond_timedwait(&drain_cond, &drain_lock, &deadline);
+            pthread_mutex_unlock(&drain_lock);
+        }
+    }
+    drain_once(outputs, scratch, rendered); // Final pass after producers have stopped
+    for (int i = 0; i < OUT_COUNT; i++) {
+        free(outputs[i].data);
+    }
+    free(scratch);
+    free(rendered);
+    return NULL;
+}
+
+/**
+ * Starts the drainer thread. Text goes to `file` (and the console); when `events` is not NULL
+ * every record is also appended to it in binary form. Messages logged before this call are
+ * written directly. Returns 0 on success, -1 on failure.
+ */
+int log_start(FILE *file, FILE *events) {
+    log_file = file;
+    event_file = events;
+    if (url_table_init(&strings) != 0) {
+        return -1;
+    }
+    strings_ready = 1;
+    if (event_file && fwrite(EVENT_LOG_MAGIC, 1, 8, event_file) != 8) {
+        return -1;
+    }
+    atomic_store(&running, 1);
+    if (pthread_create(&drainer, NULL, drain_rings, NULL) != 0) {
+        atomic_store(&running, 0);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Stops the drainer after it has written everything still buffered, and frees all rings.
+ * Must be called after every other logging thread has finished.
+ */
+void log_stop(void) {
+    if (!atomic_load(&running)) {
+        return;
+    }
+    atomic_store(&running, 0);
+    pthread_cond_signal(&drain_cond);
+    pthread_join(drainer, NULL);
+    LogRing *ring = atomic_exchange(&rings, NULL);
+    while (ring) {
+        LogRing *next = ring->next;
+        free(ring);
+        ring = next;
+    }
+    thread_ring = NULL;
+    strings_ready = 0;
+    url_table_destroy(&strings);
+}
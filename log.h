@@ -0,0 +1,62 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "events.h"
+
+// Crawler logging. Every thread formats its messages into its own single-producer ring
+// buffer without taking a lock; one drainer thread collects the rings and writes the
+// output to stdout, stderr and the log file in large blocks.
+// Hot-path messages are recorded as structured events (see events.h): the producer only
+// copies a few numeric fields, and the drainer renders them to text and appends the raw
+// records to the binary event log. Rings are merged by timestamp, so lines come out in
+// the order they were logged.
+#define LOG_TO_STDOUT 1
+#define LOG_TO_STDERR 2
+#define LOG_TO_FILE 4
+#define LOG_TO_CONSOLE_AND_FILE (LOG_TO_STDOUT | LOG_TO_FILE)
+#define LOG_TO_ERROR_AND_FILE (LOG_TO_STDERR | LOG_TO_FILE)
+
+// Log levels, most to least severe. Messages above the selected level are skipped
+// before any formatting or string interning, so a disabled level costs one branch.
+typedef enum {
+    LOG_ERROR = 0,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG,
+    LOG_TRACE,
+    LOG_LEVEL_COUNT
+} LogLevel;
+
+#define LOG_DEFAULT_LEVEL LOG_INFO
+#define LOG_SAMPLE_OFF UINT32_MAX // Sampling rate that drops every event of a type
+
+extern int log_level;                                // Highest level that is logged
+extern uint32_t log_sample_rate[EVENT_TYPE_COUNT]; // Log only every Nth event of a type (0 or 1 = all)
+
+#define LOG_ENABLED(level) ((level) <= log_level)
+#define LOG_EVENT_ENABLED(level, event) \
+    (LOG_ENABLED(level) && (log_sample_rate[event] <= 1 || log_sample(event)))
+// Records an event if its level is enabled and it survives sampling; the fields are only evaluated then
+#define LOG_EVENT(level, event, count, ...) \
+    do { \
+        if (LOG_EVENT_ENABLED(level, event)) { \
+            log_event(event, count, (uint64_t[]){__VA_ARGS__}); \
+        } \
+    } while (0)
+
+#define LOG_RING_SIZE (256 * 1024)   // Bytes per thread ring (power of two)
+#define LOG_LINE_MAX 4096            // Messages longer than this are formatted on the heap
+#define LOG_DRAIN_INTERVAL_MS 20     // Drainer wakes up at least this often
+
+int log_start(FILE *file, FILE *events);
+void log_message(int targets, const char *format, ...);
+void log_event(int event, int field_count, const uint64_t *fields);
+uint64_t log_string(const char *s);
+int log_sample(int event);
+int log_set_level(const char *name);
+int log_set_sampling(const char *spec);
+void log_stop(void);
+
+#endif
@@ -0,0 +1,185 @@
+// Offline decoder for the crawler's binary event log.
+// Renders crawler_events.bin as the text the crawler logs, or as one JSON object per line.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "events.h"
+
+#define RENDER_MAX 65536 // Largest rendering of a single event
+
+// Interned strings collected from the EVENT_STRING definitions, indexed by id
+typedef struct {
+    char **strings;
+    size_t capacity;
+} StringTable;
+
+/**
+ * Prints usage information.
+ */
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--json] EVENT_LOG\n", program);
+    fprintf(stderr, "  --json  print one JSON object per event instead of log text\n");
+}
+
+static const char *lookup(void *context, uint64_t id) {
+    StringTable *table = context;
+    return id < table->capacity ? table->strings[id] : NULL;
+}
+
+/**
+ * Records a string definition. Returns 0 on success, -1 if memory runs out.
+ */
+static int define_string(StringTable *table, uint64_t id, const char *s, size_t length) {
+    if (id >= UINT32_MAX) {
+        return -1;
+    }
+    if (id >= table->capacity) {
+        size_t new_capacity = table->capacity ? table->capacity : 1024;
+        while (new_capacity <= id) {
+            new_capacity *= 2;
+        }
+        char **grown = realloc(table->strings, new_capacity * sizeof(char *));
+        if (!grown) {
+            return -1;
+        }
+        memset(grown + table->capacity, 0, (new_capacity - table->capacity) * sizeof(char *));
+        table->strings = grown;
+        table->capacity = new_capacity;
+    }
+    char *copy = malloc(length + 1);
+    if (!copy) {
+        return -1;
+    }
+    memcpy(copy, s, length);
+    copy[length] = '\0';
+    free(table->strings[id]);
+    table->strings[id] = copy;
+    return 0;
+}
+
+/**
+ * Reads a whole file into memory. Returns NULL on failure.
+ */
+static char *read_file(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    char *data = NULL;
+    size_t length = 0, capacity = 0;
+    while (1) {
+        if (length == capacity) {
+            capacity = capacity ? capacity * 2 : 1 << 20;
+            char *grown = realloc(data, capacity);
+            if (!grown) {
+                free(data);
+                fclose(file);
+                return NULL;
+            }
+            data = grown;
+        }
+        size_t n = fread(data + length, 1, capacity - length, file);
+        if (n == 0) {
+            break;
+        }
+        length += n;
+    }
+    int failed = ferror(file);
+    fclose(file);
+    if (failed) {
+        free(data);
+        return NULL;
+    }
+    *size = length;
+    return data;
+}
+
+/**
+ * Walks the records of the log. Definitions are collected on the first pass so that
+ * events can be rendered even if they were drained before the string they refer to.
+ * Returns 0 on success, -1 if the file is truncated or malformed.
+ */
+static int decode(const char *data, size_t size, int json, StringTable *table, int render_pass, char *out) {
+    size_t offset = 8;
+    while (offset < size) {
+        EventHeader header;
+        if (size - offset < sizeof(header)) {
+            return -1;
+        }
+        memcpy(&header, data + offset, sizeof(header));
+        offset += sizeof(header);
+        size_t field_bytes = (size_t)header.field_count * sizeof(uint64_t);
+        if (header.field_count > EVENT_MAX_FIELDS || size - offset < field_bytes + header.length) {
+            return -1;
+        }
+        uint64_t fields[EVENT_MAX_FIELDS] = {0};
+        memcpy(fields, data + offset, field_bytes);
+        const char *raw = data + offset + field_bytes;
+        offset += field_bytes + header.length;
+
+        if (!render_pass) {
+            if (header.event == EVENT_STRING && header.field_count >= 1 &&
+                define_string(table, fields[0], raw, header.length) != 0) {
+                return -1;
+            }
+            continue;
+        }
+        if (!json && header.event == EVENT_STRING) {
+            continue;
+        }
+        size_t length = json ? event_render_json(&header, fields, raw, lookup, table, out, RENDER_MAX)
+                             : event_render_text(&header, fields, raw, lookup, table, out, RENDER_MAX);
+        fwrite(out, 1, length, stdout);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    int json = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = 1;
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    size_t size = 0;
+    char *data = read_file(path, &size);
+    if (!data) {
+        perror("Error reading event log");
+        return 1;
+    }
+    if (size < 8 || memcmp(data, EVENT_LOG_MAGIC, 8) != 0) {
+        fprintf(stderr, "Error: %s is not a crawler event log\n", path);
+        free(data);
+        return 1;
+    }
+
+    StringTable table = {NULL, 0};
+    char *out = malloc(RENDER_MAX);
+    int status = 0;
+    if (!out || decode(data, size, json, &table, 0, out) != 0) {
+        fprintf(stderr, "Error: %s is truncated or malformed\n", path);
+        status = 1;
+    }
+    // Render whatever was readable, even from a log cut short by a crash
+    if (out) {
+        decode(data, size, json, &table, 1, out);
+    }
+    for (size_t i = 0; i < table.capacity; i++) {
+        free(table.strings[i]);
+    }
+    free(table.strings);
+    free(out);
+    free(data);
+    return status;
+}
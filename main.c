@@ -4,523 +4,1691 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h> // for matching header names case-insensitively
 #include <pthread.h>
+#include <stdatomic.h> // for the URL queue's pending count
 #include <unistd.h>
 #include <curl/curl.h> // for downloading web pages
-#include <ctype.h>  // for character handling functions like tolower
 #include <time.h> // for timestamping or time functions (if used)
+#include <errno.h> // for reporting store and graph write errors
+#include <sys/resource.h> // for reporting peak memory
+#include "log.h" // for per-thread buffered logging
+#include "content_store.h" // for deduplicated page storage
+#include "simhash.h" // for near-duplicate detection
+#include "url_table.h" // for URL ids
+#include "link_graph.h" // for recording the link graph
+#include "pagerank.h" // for ranking crawled URLs
+#include "metrics.h" // for throughput and latency metrics
+#include "trace.h" // for Chrome trace timelines
+#include "lock_profile.h" // for optional mutex contention profiling
+#include "html_parse.h" // for word counting, link extraction and URL resolution
+#include "visited_set.h" // for skipping URLs already queued
+#include "recording.h" // for recording and replaying responses
+#include "stage_queue.h" // for handing pages between pipeline stages
+#include "work_pool.h" // for scheduling parse work across threads
+#include "mpmc_queue.h" // for the lock-free URL queue
+#include "host_limits.h" // for adaptive per-host request limits
+#include "timer_wheel.h" // for scheduling fetch retries
 
 // Constants for basic settings
 #define BASE_URL "https://books.toscrape.com/catalogue/category/books/travel_2/index.html" // Website to start crawling
 #define MAX_URL_LENGTH 1000 // Maximum length of a URL string
-#define MAX_DEPTH 2 // Maximum depth for recursive crawling
-#define MAX_THREADS 10 // Number of threads for parallel crawling
+#define MAX_DEPTH 2 // Default maximum depth for recursive crawling
+#define MAX_DEPTH_LIMIT 16 // Largest maximum depth accepted by --max-depth
+#define FETCH_SLOTS_PER_CPU 8 // Fetch threads active at the start per CPU, when sized automatically
+#define FETCH_THREADS_PER_CPU 32 // Most fetch threads per CPU the worker controller can activate
+#define CONTROL_INTERVAL_MS 1000 // How often the worker controller adjusts the active fetch threads
+#define MAX_STAGE_THREADS 256 // Most threads accepted for one pipeline stage
+#define WRITE_THREADS 1 // Default number of write threads
+#define STAGE_QUEUE_CAPACITY 64 // Pages that can wait between two pipeline stages
+#define URL_QUEUE_CAPACITY 1024 // URLs that can wait in each lane of the URL queue
+#define FETCH_RETRIES 3 // Default retries of a fetch that failed transiently
+#define RETRY_BASE_DELAY_MS 500 // Delay before the first retry, doubled for every further one
+#define RETRY_MAX_DELAY_MS 30000 // Longest delay between retries
+#define RETRY_TICK_MS 10 // Resolution of the retry timer wheel
+#define CONNECT_TIMEOUT 10 // Default seconds to connect to a host
+#define TRANSFER_TIMEOUT 60 // Default seconds a whole transfer may take
+#define STALL_TIMEOUT 15 // Default seconds a transfer may stay below STALL_SPEED before it is aborted
+#define STALL_SPEED 1024 // Bytes per second under which a transfer counts as stalled
+#define MAX_BODY_SIZE (8L * 1024 * 1024) // Default bytes of a body kept; longer bodies are truncated
 #define LOG_FILE "crawler_log.txt" // Log file name
+#define EVENT_LOG_FILE "crawler_events.bin" // Binary event log, read with logdecode
 #define URLS_FILE "urls.txt" // File to save visited URLs
-// Limit for number of URLs per depth
+// Default limit for number of URLs per depth
 #define MAX_URLS_PER_DEPTH 5
+#define STATS_INTERVAL 5 // Default seconds between stats lines
+
+// Runtime options set from the command line
+typedef struct {
+    const char *start_url;  // Page the crawl starts from (links outside its host are not crawled)
+    int max_depth;          // URLs at this depth or deeper are not fetched
+    int max_urls_per_depth; // URLs enqueued per depth
+    int fetch_threads;      // Threads downloading pages (0 = sized from the CPU count and adjusted while crawling)
+    int parse_threads;      // Threads analyzing pages (0 = one per online CPU)
+    int write_threads;      // Threads writing pages to the store
+    int pagerank;         // Compute PageRank over the link graph once the crawl finishes
+    int pagerank_threads; // Threads used for PageRank (0 = one per online CPU)
+    int stats_interval;   // Seconds between stats lines (0 = off)
+    int metrics_port;     // Port of the Prometheus metrics endpoint on 127.0.0.1 (0 = off)
+    int fetch_retries;    // Retries of a fetch that failed transiently (timeout, 503, dropped connection)
+    int connect_timeout;  // Seconds to connect to a host (0 = curl's default)
+    int transfer_timeout; // Seconds a whole transfer may take (0 = no limit)
+    int stall_timeout;    // Seconds a transfer may stay below STALL_SPEED (0 = no limit)
+    long max_body_size;   // Bytes of a body kept before the transfer is cut off (0 = STORE_MAX_BODY_LENGTH)
+    const char *trace_path; // Chrome trace JSON written at the end of the crawl (NULL = no tracing)
+    const char *record_path; // File every response is recorded to (NULL = no recording)
+    const char *replay_path; // Recording that responses are replayed from instead of the network (NULL = live crawl)
+} CrawlerOptions;
 
 // Important words to search for inside the HTML pages
 const char *important_words[] = {"data", "star", "math", "generate", "link", "information"};
 const int word_count = sizeof(important_words) / sizeof(important_words[0]);
 
+// Crawl priority of a URL; links found on near-duplicate pages are only crawled when nothing else is waiting
+#define URL_PRIORITY_NORMAL 0
+#define URL_PRIORITY_LOW 1
+#define URL_PRIORITY_LEVELS 2
+
 // Structure to store a URL along with its crawl depth 
 typedef struct {
     char url[MAX_URL_LENGTH];
     int depth;
+    int priority;
+    int attempt; // Transient fetch failures so far
 } URL;
 
-// Structure to represent a thread-safe queue for URLs
+// Structure holding a page body while it downloads, along with its running content fingerprint
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    size_t wire_length; // Body bytes as they arrived, before content decoding
+    size_t limit;      // Most bytes kept (0 = no limit)
+    int truncated;     // Set once the body reached the limit and the rest was dropped
+    const char *rejected; // Why the headers ruled the body out before it downloaded (NULL = they did not)
+    FingerprintState fingerprint;
+} PageBuffer;
+
+// A fetched page on its way through the parse and write stages
+typedef struct {
+    URL url;
+    int page;          // Page number
+    PageBuffer body;   // Downloaded body, freed by the write stage
+    Fingerprint fp;
+    long body_id;      // Body in the content store (-1 if none could be claimed)
+    int is_new;        // 1 = first page with this body, 0 = exact duplicate, -1 = store error
+    uint64_t simhash;
+} PageTask;
+
+// Raw response headers of a transfer, collected only while recording
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} ResponseHeaders;
+
+// State of headerCallback over the responses of one transfer (redirects included)
+typedef struct {
+    PageBuffer *page;
+    ResponseHeaders *recorded; // Where raw headers are kept (NULL unless recording)
+    long status;               // Status of the response whose headers are arriving
+} HeaderFilter;
+
+// Structure collecting the ids of the URLs a page links to, recorded in the link graph once per page
+typedef struct {
+    uint32_t *ids;
+    size_t count;
+    size_t capacity;
+} LinkIdList;
+
+// Same-site links of one page, collected so they are checked and queued together
 typedef struct {
-    URL data[MAX_URL_LENGTH]; // Array of URLs
-    int front, rear; // Tracks indices for front and rear of the queue
-    pthread_mutex_t lock; // Mutex for thread-safe access ensures one thread mutates at a time
-    pthread_cond_t cond; // Condition variable for thread waiting when queue is empty until new URL arrives
+    char *text;        // The URLs back to back, NUL-terminated
+    size_t length;
+    size_t capacity;
+    size_t *offsets;   // Start of every URL in text
+    size_t count;
+    size_t offset_capacity;
+} LinkBatch;
+
+// Structure to represent a thread-safe queue for URLs, with one lock-free FIFO lane per priority level
+typedef struct {
+    MpmcQueue lanes[URL_PRIORITY_LEVELS];
+    _Atomic int pending; // URLs queued or still being fetched or parsed; the crawl is done when it drops to 0
+    _Atomic int done; // Set once pending drops to 0
+    Parker idle; // Fetch threads waiting for a URL to arrive
 } URLQueue;
 
+// A URL waiting in the timer wheel to be fetched again
+typedef struct {
+    TimerEntry timer; // First, so expired timers can be cast back to their task
+    URL url;
+} RetryTask;
+
 // Global variables for the crawler
+CrawlerOptions options = {BASE_URL, MAX_DEPTH, MAX_URLS_PER_DEPTH, 0, 0, WRITE_THREADS, 0, 0, STATS_INTERVAL, 0, FETCH_RETRIES,
+                          CONNECT_TIMEOUT, TRANSFER_TIMEOUT, STALL_TIMEOUT, MAX_BODY_SIZE, NULL, NULL, NULL};
 URLQueue urlQueue;
-pthread_t threads[MAX_THREADS]; //pThread IDs
+WorkPool parsePool; // Fetched pages waiting for the parse stage
+StageQueue writeQueue; // Parsed pages waiting for the write stage
 FILE *logFile;
+FILE *eventFile;
 FILE *urlsFile;
-int done = 0;    // Flag to indicate if crawling is done
-pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
-int urls_per_depth[MAX_DEPTH];
-pthread_mutex_t print_lock = PTHREAD_MUTEX_INITIALIZER;
+int urls_per_depth[MAX_DEPTH_LIMIT];
 pthread_mutex_t urls_per_depth_lock = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t urls_file_lock = PTHREAD_MUTEX_INITIALIZER;
-char *visited_urls[MAX_URL_LENGTH];
-int visited_count = 0;
+VisitedSet visited_urls; // URLs already queued, up to MAX_URL_LENGTH of them
 pthread_mutex_t visited_lock = PTHREAD_MUTEX_INITIALIZER;
+int stats_done = 0; // Flag telling the stats thread the crawl is over
+pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t stats_cond = PTHREAD_COND_INITIALIZER;
+_Atomic int fetch_limit; // Fetch threads numbered below this are active, the rest wait
+pthread_mutex_t fetch_limit_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t fetch_limit_cond = PTHREAD_COND_INITIALIZER;
+TimerWheel retryWheel; // URLs waiting to be fetched again after a transient failure
+int retry_limit; // Retries per URL in this crawl (0 when retries are off)
+SimhashIndex simhash_index; // SimHashes of all analyzed pages, for near-duplicate lookups
+UrlTable url_table; // Ids of every URL seen as a page or link target
 
 /**
- * Initializes a URL queue by setting the front and rear to -1 and
- * initializing its mutex and condition variable.
+ * Initializes a URL queue with room for URL_QUEUE_CAPACITY URLs in every lane.
+ * Returns 0 on success, -1 if out of memory.
  */
-void initQueue(URLQueue *queue) {
-    queue->front = queue->rear = -1;
-    pthread_mutex_init(&queue->lock, NULL);
-    pthread_cond_init(&queue->cond, NULL);
+int initQueue(URLQueue *queue) {
+    for (int i = 0; i < URL_PRIORITY_LEVELS; i++) {
+        if (mpmc_queue_init(&queue->lanes[i], URL_QUEUE_CAPACITY, sizeof(URL)) != 0) {
+            while (--i >= 0) {
+                mpmc_queue_destroy(&queue->lanes[i]);
+            }
+            return -1;
+        }
+    }
+    atomic_init(&queue->pending, 0);
+    atomic_init(&queue->done, 0);
+    parker_init(&queue->idle);
+    return 0;
+}
+
+void destroyQueue(URLQueue *queue) {
+    for (int i = 0; i < URL_PRIORITY_LEVELS; i++) {
+        mpmc_queue_destroy(&queue->lanes[i]);
+    }
+    parker_destroy(&queue->idle);
 }
 
 /**
- * Saves the HTML content of a page to a local file (page_X.html) where X is the index.
- * Logs success or error information into the log file.
+ * Looks the body of a page up in the content-addressed store, claiming a body id for it
+ * if it has not been seen, so exact duplicates are known before the body is written.
+ * Returns 1 if the body is new, 0 if it is a duplicate, and -1 on error.
  */
-void save_html(const char *html_content, int index, const char *url) {
-    if (!html_content) {
-        pthread_mutex_lock(&print_lock);
-        fprintf(stderr, "Error: html_content is NULL in save_html for URL: %s\n", url);
-        fprintf(logFile, "Error: html_content is NULL in save_html for URL: %s\n", url);
-        fflush(logFile);
-        pthread_mutex_unlock(&print_lock);
-        return;
+int claim_html(PageTask *task) {
+    int is_new = 0;
+    task->body_id = store_claim_body(&task->fp, &is_new);
+    if (task->body_id < 0) {
+        log_message(LOG_TO_ERROR_AND_FILE, "Error: out of memory in page store for page_%d, URL: %s\n", task->page,
+                    task->url.url);
+        return -1;
     }
-    char filename[100];
-    snprintf(filename, sizeof(filename), "page_%d.html", index); // Generate filename
-    FILE *file = fopen(filename, "w");
-
-    if (file) {
-        // Save the content to file
-        fprintf(file, "%s", html_content);
-        fclose(file);
-         // Log the successful save
-        pthread_mutex_lock(&print_lock);
-        printf("HTML content saved to %s for URL: %s\n", filename, url);
-        fprintf(logFile, "HTML content saved to %s for URL: %s\n", filename, url);
-        fflush(logFile);
-        pthread_mutex_unlock(&print_lock);
-    } else {
-        // Log any file opening error
-        pthread_mutex_lock(&print_lock);
-        perror("Error opening output file");
-        fprintf(logFile, "Error opening output file: %s for URL: %s\n", filename, url);
-        fflush(logFile);
-        pthread_mutex_unlock(&print_lock);
+    return is_new;
+}
+
+/**
+ * Saves the HTML content of a page claimed by claim_html into the content-addressed store.
+ * Bodies already stored under the same fingerprint are not written again.
+ * Returns 0 on success and -1 on error.
+ */
+int save_html(const PageTask *task) {
+    if (task->is_new > 0 &&
+        store_write_body(task->body_id, &task->fp, task->body.data, task->body.length) != 0) {
+        // Log any store write error
+        log_message(LOG_TO_STDERR, "Error writing to page store: %s\n", strerror(errno));
+        log_message(LOG_TO_FILE, "Error writing page_%d to page store for URL: %s\n", task->page, task->url.url);
+        return -1;
     }
+    LOG_EVENT(LOG_INFO, task->is_new ? EVENT_PAGE_SAVED : EVENT_PAGE_DUPLICATE, 5, task->page, task->body_id,
+              task->fp.hi, task->fp.lo, log_string(task->url.url));
+    return 0;
 }
 
 /**
  * Finds and counts occurrences of important words in the HTML content.
  * It prints and logs how many times each important word appears on a page.
+ * Returns the page's SimHash, computed in the same walk over the words.
  */
-void word_finder(const char *html_content, int page_index, const char *url) {
+uint64_t word_finder(const char *html_content, int page_index, const char *url) {
     if (!html_content) {
-        pthread_mutex_lock(&print_lock);
-        fprintf(stderr, "Error: html_content is NULL in word_finder for URL: %s\n", url);
-        fprintf(logFile, "Error: html_content is NULL in word_finder for URL: %s\n", url);
-        fflush(logFile);
-        pthread_mutex_unlock(&print_lock);
-        return;
+        log_message(LOG_TO_ERROR_AND_FILE, "Error: html_content is NULL in word_finder for URL: %s\n", url);
+        return 0;
     }
     int count[word_count];
-    memset(count, 0, sizeof(count)); // Initialize count array to 0
-
-    // Make a lowercase copy of the HTML content to make search case-insensitive
-    char *lowercase_content = strdup(html_content);
-    if (!lowercase_content) {
-        pthread_mutex_lock(&print_lock);
-        perror("Failed to allocate memory for lowercase_content");
-        fprintf(logFile, "Failed to allocate memory for lowercase_content for URL: %s\n", url);
-        fflush(logFile);
-        pthread_mutex_unlock(&print_lock);
+    uint64_t simhash = html_count_words(html_content, important_words, word_count, count);
+    // Print and log the word counts as one event
+    if (LOG_EVENT_ENABLED(LOG_INFO, EVENT_WORD_COUNTS)) {
+        uint64_t fields[2 + 2 * word_count];
+        fields[0] = page_index;
+        fields[1] = log_string(url);
+        for (int i = 0; i < word_count; i++) {
+            fields[2 + 2 * i] = log_string(important_words[i]);
+            fields[3 + 2 * i] = count[i];
+        }
+        log_event(EVENT_WORD_COUNTS, 2 + 2 * word_count, fields);
+    }
+    return simhash;
+}
+
+/**
+ * Adds a page's SimHash to the near-duplicate index and reports whether an earlier page
+ * is within SIMHASH_MAX_DISTANCE bits of it.
+ * Returns 1 if the page is a near-duplicate, 0 otherwise.
+ */
+int flag_near_duplicate(uint64_t simhash, int page_index, const char *url) {
+    int match_page = 0;
+    int found = simhash_index_add(&simhash_index, simhash, page_index, &match_page);
+    if (found < 0) {
+        log_message(LOG_TO_ERROR_AND_FILE, "Error: out of memory in near-duplicate index for URL: %s\n", url);
+        return 0;
+    }
+    if (found) {
+        LOG_EVENT(LOG_INFO, EVENT_NEAR_DUPLICATE, 3, page_index, match_page, log_string(url));
+    }
+    return found;
+}
+
+/**
+ * Adds the id of a link target to a page's link list. Links that cannot be recorded
+ * (out of memory) are left out of the graph but still crawled.
+ */
+void record_link(LinkIdList *links, const char *url) {
+    uint32_t id = url_table_intern(&url_table, url);
+    if (id == URL_ID_NONE) {
         return;
     }
-     // Convert all characters to lowercase
-    for (char *p = lowercase_content; *p; ++p) {
-        *p = tolower(*p);
-    }
-     // Count occurrences of each important word
-    for (int i = 0; i < word_count; i++) {
-        char *ptr = lowercase_content;
-        while ((ptr = strstr(ptr, important_words[i])) != NULL) {
-            int word_len = strlen(important_words[i]);
-            char before = (ptr == lowercase_content) ? ' ' : *(ptr - 1);
-            char after = ptr[word_len];
-            // Check if the word is not part of another word (by checking surrounding characters)
-            if ((before == ' ' || ispunct(before) || before == '\n' || before == '\t') &&
-                (after == ' ' || ispunct(after) || after == '\n' || after == '\t' || after == '\0')) {
-                count[i]++;
-            }
-            ptr += word_len;
+    if (links->count == links->capacity) {
+        size_t new_capacity = links->capacity ? links->capacity * 2 : 64;
+        uint32_t *ids = realloc(links->ids, new_capacity * sizeof(uint32_t));
+        if (!ids) {
+            return;
         }
+        links->ids = ids;
+        links->capacity = new_capacity;
     }
-    // Print and log the word counts
-    pthread_mutex_lock(&print_lock);
-    printf("Word counts for page_%d (URL: %s):\n", page_index, url);
-    fprintf(logFile, "Word counts for page_%d (URL: %s):\n", page_index, url);
-    for (int i = 0; i < word_count; i++) {
-        printf("The word '%s' appears %d times on page_%d.\n", important_words[i], count[i], page_index);
-        fprintf(logFile, "The word '%s' appears %d times on page_%d.\n", important_words[i], count[i], page_index);
+    links->ids[links->count++] = id;
+}
+
+/**
+ * Appends a URL to a page's link batch. Returns 0 on success, -1 if out of memory.
+ */
+static int link_batch_add(LinkBatch *batch, const char *url) {
+    size_t length = strlen(url) + 1;
+    if (batch->length + length > batch->capacity) {
+        size_t new_capacity = batch->capacity ? batch->capacity * 2 : 4096;
+        while (new_capacity < batch->length + length) {
+            new_capacity *= 2;
+        }
+        char *text = realloc(batch->text, new_capacity);
+        if (!text) {
+            return -1;
+        }
+        batch->text = text;
+        batch->capacity = new_capacity;
     }
-    printf("--- End of word counts for page_%d ---\n", page_index);
-    fprintf(logFile, "--- End of word counts for page_%d ---\n", page_index);
-    fflush(logFile);
-    pthread_mutex_unlock(&print_lock);
-    free(lowercase_content); // Free allocated memory
+    if (batch->count == batch->offset_capacity) {
+        size_t new_capacity = batch->offset_capacity ? batch->offset_capacity * 2 : 64;
+        size_t *offsets = realloc(batch->offsets, new_capacity * sizeof(size_t));
+        if (!offsets) {
+            return -1;
+        }
+        batch->offsets = offsets;
+        batch->offset_capacity = new_capacity;
+    }
+    memcpy(batch->text + batch->length, url, length);
+    batch->offsets[batch->count++] = batch->length;
+    batch->length += length;
+    return 0;
+}
+
+/**
+ * Orders URL pointers by text, and copies of the same URL by position in the batch.
+ */
+static int compare_link_text(const void *a, const void *b) {
+    const char *left = *(const char *const *)a;
+    const char *right = *(const char *const *)b;
+    int order = strcmp(left, right);
+    if (order != 0) {
+        return order;
+    }
+    return (left > right) - (left < right);
+}
+
+/**
+ * Lists the distinct URLs of a batch in the order they first appear on the page.
+ * Returns a malloc'ed array of pointers into the batch and sets `count`, or NULL if out
+ * of memory. Later copies of a URL are blanked in the batch.
+ */
+static const char **link_batch_unique(LinkBatch *batch, size_t *count) {
+    const char **urls = malloc(batch->count * sizeof(char *));
+    if (!urls) {
+        return NULL;
+    }
+    for (size_t i = 0; i < batch->count; i++) {
+        urls[i] = batch->text + batch->offsets[i];
+    }
+    qsort(urls, batch->count, sizeof(char *), compare_link_text);
+    const char *first = NULL; // First copy of the current run of equal URLs
+    for (size_t i = 0; i < batch->count; i++) {
+        if (first && strcmp(urls[i], first) == 0) {
+            batch->text[urls[i] - batch->text] = '\0';
+        } else {
+            first = urls[i];
+        }
+    }
+    size_t unique = 0;
+    for (size_t i = 0; i < batch->count; i++) {
+        if (batch->text[batch->offsets[i]] != '\0') {
+            urls[unique++] = batch->text + batch->offsets[i];
+        }
+    }
+    *count = unique;
+    return urls;
 }
+
 /**
  * Saves a URL into the "urls.txt" file in a thread-safe way.
  */
 void save_url_to_file(const char *url) {
-    pthread_mutex_lock(&urls_file_lock);
+    MUTEX_LOCK(&urls_file_lock);
     fprintf(urlsFile, "%s\n", url);
     fflush(urlsFile);
-    pthread_mutex_unlock(&urls_file_lock);
+    MUTEX_UNLOCK(&urls_file_lock);
 }
+
 /**
- * Adds a URL to the URL queue in a thread-safe manner.
- * If the queue is full, logs an error and discards the URL.
+ * Marks a dequeued URL as fully processed (its links, if any, are queued). Once no URL is
+ * queued or in flight anywhere in the pipeline, the crawl is done and idle fetch threads
+ * are woken up to exit.
  */
-void enqueue(URLQueue *queue, const URL *url) {
-    pthread_mutex_lock(&queue->lock);
-    if (queue->rear == MAX_URL_LENGTH - 1) {
+void finish_url(URLQueue *queue) {
+    if (atomic_fetch_sub(&queue->pending, 1) == 1) {
+        atomic_store(&queue->done, 1);
+        parker_wake(&queue->idle, PARKER_WAKE_ALL);
+        MUTEX_LOCK(&fetch_limit_lock);
+        pthread_cond_broadcast(&fetch_limit_cond); // Inactive fetch threads exit too
+        MUTEX_UNLOCK(&fetch_limit_lock);
+    }
+}
+
+/**
+ * Adds URLs of the same depth and priority to the matching lane of the URL queue without
+ * locking, then wakes as many waiting threads as there are new URLs with a single call.
+ * URLs that do not fit in a full lane are logged and discarded.
+ */
+void enqueue_batch(URLQueue *queue, const char *urls[], size_t count, int depth, int priority) {
+    if (count == 0) {
+        return;
+    }
+    // Count the URLs before they become visible, so pending cannot reach 0 while they are queued
+    atomic_fetch_add(&queue->pending, (int)count);
+    metrics_gauge_add(METRIC_QUEUE_DEPTH, (int64_t)count);
+    URL url;
+    url.depth = depth;
+    url.priority = priority;
+    url.attempt = 0;
+    size_t queued = 0;
+    for (size_t i = 0; i < count; i++) {
+        strcpy(url.url, urls[i]); // Resolved URLs are shorter than MAX_URL_LENGTH
+        if (mpmc_queue_push(&queue->lanes[priority], &url) == 0) {
+            queued++;
+            continue;
+        }
         // Queue is full; cannot enqueue
-        pthread_mutex_unlock(&queue->lock);
-        pthread_mutex_lock(&print_lock);
-        fprintf(logFile, "Queue full, cannot enqueue URL: %s\n", url->url);
-        fflush(logFile);
-        pthread_mutex_unlock(&print_lock);
+        metrics_gauge_add(METRIC_QUEUE_DEPTH, -1);
+        if (LOG_ENABLED(LOG_WARN)) {
+            log_message(LOG_TO_FILE, "Queue full, cannot enqueue URL: %s\n", url.url);
+        }
+        finish_url(queue);
+    }
+    if (queued > 0) {
+        parker_wake(&queue->idle, queued < PARKER_WAKE_ALL ? (int)queued : PARKER_WAKE_ALL); // Wake up threads waiting for URLs
+    }
+}
+
+/**
+ * Adds a single URL to the URL queue.
+ */
+void enqueue(URLQueue *queue, const URL *url) {
+    const char *text = url->url;
+    enqueue_batch(queue, &text, 1, url->depth, url->priority);
+}
+
+/**
+ * Puts a URL that is already counted as pending back into its lane, keeping its retry
+ * count. If the lane is full the URL is logged and discarded.
+ */
+static void requeue(URLQueue *queue, const URL *url) {
+    metrics_gauge_add(METRIC_QUEUE_DEPTH, 1);
+    if (mpmc_queue_push(&queue->lanes[url->priority], url) == 0) {
+        parker_wake(&queue->idle, 1);
         return;
     }
-    if (queue->front == -1)
-        queue->front = 0;
-    queue->rear++;
-    queue->data[queue->rear] = *url; // Copy the URL into the queue
-    pthread_cond_signal(&queue->cond);  // Wake up any thread waiting for URLs
-    pthread_mutex_unlock(&queue->lock);
+    metrics_gauge_add(METRIC_QUEUE_DEPTH, -1);
+    if (LOG_ENABLED(LOG_WARN)) {
+        log_message(LOG_TO_FILE, "Queue full, cannot enqueue URL: %s\n", url->url);
+    }
+    finish_url(queue);
 }
 
 /**
- * Checks if the URL queue is empty.
- * Returns 1 (true) if empty, otherwise 0 (false).
+ * Takes a URL from the highest-priority non-empty lane. Returns 1 if one was taken.
  */
-int isEmpty(URLQueue *queue) {
-    return queue->front == -1 || queue->front > queue->rear;
+static int take_url(URLQueue *queue, URL *url) {
+    for (int i = 0; i < URL_PRIORITY_LEVELS; i++) {
+        if (mpmc_queue_pop(&queue->lanes[i], url) == 0) {
+            metrics_gauge_add(METRIC_QUEUE_DEPTH, -1);
+            return 1;
+        }
+    }
+    return 0;
 }
 
 /**
- * Dequeues a URL from the front of the URL queue in a thread-safe way.
+ * Dequeues a URL from the front of the highest-priority non-empty lane.
  * If queue is empty and crawling is done, returns an empty URL struct.
- * Otherwise, waits until a URL is available.
+ * Otherwise, parks until a URL is available.
  */
 URL dequeue(URLQueue *queue) {
-    pthread_mutex_lock(&queue->lock);
-    while (isEmpty(queue)) {
-        pthread_mutex_lock(&done_lock);
-        if (done) {
-            pthread_mutex_unlock(&done_lock);
-            pthread_mutex_unlock(&queue->lock);
-            URL empty_url = {{0}, 0}; // Return empty URL
+    URL url;
+    while (!take_url(queue, &url)) {
+        uint32_t epoch = parker_prepare(&queue->idle);
+        if (take_url(queue, &url)) {
+            parker_cancel(&queue->idle);
+            break;
+        }
+        if (atomic_load(&queue->done)) {
+            parker_cancel(&queue->idle);
+            URL empty_url = {{0}, 0, URL_PRIORITY_NORMAL, 0}; // Return empty URL
             return empty_url;
         }
-        pthread_mutex_unlock(&done_lock);
-        pthread_cond_wait(&queue->cond, &queue->lock); // Wait until URL is available
+        parker_wait(&queue->idle, epoch); // Wait until URL is available
     }
-    URL url = queue->data[queue->front++];
-    pthread_mutex_unlock(&queue->lock);
     return url;
 }
 
 /**
  * Callback function used by libcurl to write the downloaded HTML data into memory.
- * Handles initial memory allocation and reallocation when more data arrives.
+ * Grows the buffer geometrically as more data arrives and feeds every chunk into the
+ * page's content fingerprint so it is ready as soon as the transfer finishes.
+ * A body that goes over the page's limit is cut there and marked truncated; taking less
+ * than the whole chunk makes curl abort the transfer with CURLE_WRITE_ERROR.
  */
 size_t writeCallback(void *ptr, size_t size, size_t nmemb, void *userp) {
     size_t totalSize = size * nmemb;
-    char **html = (char **)userp;
-
-    if (*html == NULL) {
-        *html = malloc(totalSize + 1);
-        if (*html == NULL) {
-            pthread_mutex_lock(&print_lock);
-            fprintf(stderr, "Error: malloc failed in writeCallback\n");
-            fprintf(logFile, "Error: malloc failed in writeCallback\n");
-            fflush(logFile);
-            pthread_mutex_unlock(&print_lock);
-            return 0;
+    PageBuffer *page = (PageBuffer *)userp;
+
+    if (page->limit > 0 && page->length + totalSize > page->limit) {
+        totalSize = page->limit - page->length;
+        page->truncated = 1;
+    }
+
+    if (page->length + totalSize + 1 > page->capacity) {
+        size_t newCapacity = page->capacity ? page->capacity : 16384;
+        while (newCapacity < page->length + totalSize + 1) {
+            newCapacity *= 2;
         }
-        memcpy(*html, ptr, totalSize);
-        (*html)[totalSize] = '\0';
-    } else {
-        size_t oldLen = strlen(*html);
-        char *newHtml = realloc(*html, oldLen + totalSize + 1);
-        if (newHtml == NULL) {
-            pthread_mutex_lock(&print_lock);
-            fprintf(stderr, "Error: realloc failed in writeCallback\n");
-            fprintf(logFile, "Error: realloc failed in writeCallback\n");
-            fflush(logFile);
-            pthread_mutex_unlock(&print_lock);
-            free(*html);
-            *html = NULL;
+        char *newData = realloc(page->data, newCapacity);
+        if (newData == NULL) {
+            log_message(LOG_TO_ERROR_AND_FILE, "Error: realloc failed in writeCallback\n");
+            free(page->data);
+            page->data = NULL;
+            page->length = page->capacity = 0;
+            page->truncated = 0; // A failed transfer, not a body cut off on purpose
             return 0;
         }
-        *html = newHtml;
-        memcpy(*html, ptr, totalSize);
-        (*html)[oldLen + totalSize] = '\0';
+        page->data = newData;
+        page->capacity = newCapacity;
+    }
+    memcpy(page->data + page->length, ptr, totalSize);
+    page->length += totalSize;
+    page->data[page->length] = '\0';
+    fingerprint_update(&page->fingerprint, ptr, totalSize);
+
+    return totalSize;
+}
+
+/**
+ * Reads the DNS, connect, TLS, time-to-first-byte and total times of a finished transfer.
+ */
+static void get_fetch_timings(CURL *curl, FetchTimings *timings) {
+    curl_off_t dns = 0, connect = 0, tls = 0, ttfb = 0, total = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &ttfb);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    *timings = (FetchTimings){(uint64_t)dns, (uint64_t)connect, (uint64_t)tls, (uint64_t)ttfb, (uint64_t)total};
+}
+
+/**
+ * Records the phase times of a transfer in the latency histograms.
+ * curl reports each phase as time since the start of the transfer, so the connect and
+ * TLS phases are the differences between consecutive timestamps.
+ */
+static void record_fetch_timings(const FetchTimings *timings) {
+    metrics_record(METRIC_DNS_TIME, timings->dns);
+    metrics_record(METRIC_CONNECT_TIME, timings->connect > timings->dns ? timings->connect - timings->dns : 0);
+    if (timings->tls > timings->connect) {
+        metrics_record(METRIC_TLS_TIME, timings->tls - timings->connect); // Only HTTPS transfers have a TLS phase
+    }
+    metrics_record(METRIC_TTFB_TIME, timings->ttfb);
+    metrics_record(METRIC_TOTAL_TIME, timings->total);
+}
+
+/**
+ * Appends a header line to the raw headers of a recorded transfer.
+ * Returns 0 on success, -1 if out of memory.
+ */
+static int keep_header(ResponseHeaders *headers, const char *buffer, size_t totalSize) {
+    if (headers->length + totalSize > headers->capacity) {
+        size_t newCapacity = headers->capacity ? headers->capacity : 1024;
+        while (newCapacity < headers->length + totalSize) {
+            newCapacity *= 2;
+        }
+        char *newData = realloc(headers->data, newCapacity);
+        if (newData == NULL) {
+            return -1;
+        }
+        headers->data = newData;
+        headers->capacity = newCapacity;
+    }
+    memcpy(headers->data + headers->length, buffer, totalSize);
+    headers->length += totalSize;
+    return 0;
+}
+
+/**
+ * Returns the value of header line `line` (`length` bytes) if it is header `name`, with
+ * surrounding blanks skipped and its length in `value_length`, or NULL otherwise.
+ */
+static const char *header_value(const char *line, size_t length, const char *name, size_t *value_length) {
+    size_t name_length = strlen(name);
+    if (length <= name_length || line[name_length] != ':' || strncasecmp(line, name, name_length) != 0) {
+        return NULL;
+    }
+    const char *value = line + name_length + 1;
+    const char *end = line + length;
+    while (value < end && (*value == ' ' || *value == '\t')) {
+        value++;
     }
+    while (end > value && (end[-1] == '\r' || end[-1] == '\n' || end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    *value_length = (size_t)(end - value);
+    return value;
+}
 
+/**
+ * Callback used by libcurl for every response header line. Rejects a 2xx response before
+ * its body is downloaded if its Content-Type is not HTML or its Content-Length is over
+ * --max-body-size; returning short makes curl abort the transfer with CURLE_WRITE_ERROR.
+ * Other responses (redirects, and errors such as a 503 with a plain-text body) are not
+ * checked, so they still reach the host limits and the retry queue. While recording,
+ * also keeps the raw headers.
+ */
+size_t headerCallback(char *buffer, size_t size, size_t nitems, void *userp) {
+    size_t totalSize = size * nitems;
+    HeaderFilter *filter = (HeaderFilter *)userp;
+    if (filter->recorded && keep_header(filter->recorded, buffer, totalSize) != 0) {
+        return 0;
+    }
+    if (totalSize > 5 && strncmp(buffer, "HTTP/", 5) == 0) {
+        const char *code = memchr(buffer, ' ', totalSize);
+        filter->status = code ? strtol(code + 1, NULL, 10) : 0; // Status line of the next response
+        return totalSize;
+    }
+    if (filter->status < 200 || filter->status >= 300) {
+        return totalSize;
+    }
+    size_t length;
+    const char *value = header_value(buffer, totalSize, "Content-Type", &length);
+    if (value && !(length >= 9 && strncasecmp(value, "text/html", 9) == 0) &&
+        !(length >= 21 && strncasecmp(value, "application/xhtml+xml", 21) == 0)) {
+        filter->page->rejected = "not HTML";
+        return 0;
+    }
+    value = header_value(buffer, totalSize, "Content-Length", &length);
+    if (value && options.max_body_size > 0 && length > 0 && length < 20) {
+        char digits[20];
+        memcpy(digits, value, length);
+        digits[length] = '\0';
+        if (strtoull(digits, NULL, 10) > (unsigned long long)options.max_body_size) {
+            filter->page->rejected = "too large";
+            return 0;
+        }
+    }
     return totalSize;
 }
 
 /**
- * Thread function for fetching and processing URLs.
- * Each thread continuously dequeues URLs, fetches HTML content, processes the page,
- * extracts new links, saves results, and enqueues new URLs to be crawled.
+ * Downloads a URL into `page` and records its timings. With --record the response is
+ * also appended to the recording; with --replay it is taken from the recording instead
+ * of the network (URLs that were not recorded fail as not found).
+ * Stores the HTTP status (0 if none arrived) in `status` and the transfer's timings in
+ * `timings`. Returns the curl result of the transfer; a body cut off at the page's size
+ * limit counts as a success, with `page->truncated` set, and a response rejected by its
+ * headers fails with CURLE_WRITE_ERROR, with `page->rejected` set.
+ */
+static CURLcode fetch_page(const char *url, PageBuffer *page, long *status, FetchTimings *timings) {
+    *status = 0;
+    memset(timings, 0, sizeof(*timings));
+    if (options.replay_path) {
+        const RecordedResponse *response = replay_find(url);
+        if (!response) {
+            return CURLE_REMOTE_FILE_NOT_FOUND;
+        }
+        *status = response->status;
+        *timings = response->timings;
+        record_fetch_timings(timings);
+        // Recorded headers go through the same checks, line by line
+        HeaderFilter filter = {page, NULL, 0};
+        const char *line = response->headers;
+        const char *end = response->headers + response->header_length;
+        while (line < end) {
+            const char *newline = memchr(line, '\n', (size_t)(end - line));
+            size_t length = newline ? (size_t)(newline - line) + 1 : (size_t)(end - line);
+            if (headerCallback((char *)line, 1, length, &filter) != length) {
+                return CURLE_WRITE_ERROR;
+            }
+            line += length;
+        }
+        if (response->body_length > 0 &&
+            writeCallback((void *)response->body, 1, response->body_length, page) != response->body_length &&
+            !page->truncated) {
+            return CURLE_WRITE_ERROR;
+        }
+        page->wire_length = page->length; // Bodies are recorded decoded
+        return (CURLcode)response->result;
+    }
+
+    CURL *curl = curl_easy_init();
+    if (!curl) {
+        return CURLE_FAILED_INIT;
+    }
+    LOG_EVENT(LOG_DEBUG, EVENT_FETCH_ATTEMPT, 1, log_string(url));
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/91.0.4472.124 Safari/537.36");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, page);
+    // Offer every content encoding this libcurl can decode (gzip, deflate, br, zstd); bodies
+    // are decoded as they stream in, so writeCallback and the size limit see decoded bytes
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    // Hard limits, so a tarpit host or a huge response cannot hold a fetch thread for long
+    if (options.connect_timeout > 0) {
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, (long)options.connect_timeout);
+    }
+    if (options.transfer_timeout > 0) {
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)options.transfer_timeout);
+    }
+    if (options.stall_timeout > 0) {
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, (long)STALL_SPEED);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)options.stall_timeout);
+    }
+    ResponseHeaders headers = {NULL, 0, 0};
+    HeaderFilter filter = {page, options.record_path ? &headers : NULL, 0};
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerCallback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &filter);
+    CURLcode res = curl_easy_perform(curl);
+    if (res == CURLE_WRITE_ERROR && page->truncated) {
+        res = CURLE_OK; // Cut off at the size limit on purpose; the page is kept as truncated
+    }
+    get_fetch_timings(curl, timings);
+    record_fetch_timings(timings);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, status);
+    curl_off_t wire_length = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &wire_length) == CURLE_OK && wire_length > 0) {
+        page->wire_length = (size_t)wire_length;
+    }
+    if (options.record_path) {
+        RecordedResponse response = {url, strlen(url), headers.data, headers.length,
+                                     page->data, page->data ? page->length : 0, (int)*status, res, *timings};
+        if (recording_add(&response) != 0) {
+            log_message(LOG_TO_ERROR_AND_FILE, "Error writing response of %s to recording %s\n", url, options.record_path);
+        }
+        free(headers.data);
+    }
+    curl_easy_cleanup(curl);
+    return res;
+}
+
+/**
+ * Ends the current stage of a page: charges its time to the stage metrics and,
+ * when tracing, records it as a span of the page.
+ */
+static void end_stage(StageTimer *timer, MetricStage stage, int page) {
+    uint64_t start = timer->wall;
+    stage_timer_lap(timer, stage);
+    trace_span(metrics_stage_name(stage), "stage", start, timer->wall, page);
+}
+
+/**
+ * Locks a mutex, recording the time spent waiting for it as a span when tracing.
+ * `name` labels the span and the lock's row in the lock profile.
+ */
+static void traced_lock(pthread_mutex_t *lock, const char *name, int page) {
+    uint64_t wait_start = trace_now();
+    MUTEX_LOCK_NAMED(lock, name);
+    trace_span(name, "lock", wait_start, trace_now(), page);
+}
+
+/**
+ * Queues a page's new links: marks them visited and charges them to the per-depth
+ * limit under one lock acquisition each, then enqueues them all with a single wakeup.
+ */
+static void queue_links(LinkBatch *batch, int depth, int priority, int page) {
+    size_t count = 0;
+    const char **urls = link_batch_unique(batch, &count);
+    if (!urls) {
+        log_message(LOG_TO_ERROR_AND_FILE, "Error: out of memory queueing links of page_%d\n", page);
+        return;
+    }
+
+    // Check which URLs were already visited
+    traced_lock(&visited_lock, "visited_lock", page);
+    count = visited_set_add_new(&visited_urls, urls, count);
+    MUTEX_UNLOCK(&visited_lock);
+
+    // Take as many URLs as the depth has room for
+    traced_lock(&urls_per_depth_lock, "urls_per_depth_lock", page);
+    int room = options.max_urls_per_depth - urls_per_depth[depth];
+    if (room < 0) {
+        room = 0;
+    }
+    if (count > (size_t)room) {
+        count = (size_t)room;
+    }
+    urls_per_depth[depth] += (int)count;
+    MUTEX_UNLOCK(&urls_per_depth_lock);
+
+    enqueue_batch(&urlQueue, urls, count, depth, priority);
+    free(urls);
+}
+
+/**
+ * Extracts the links of a page, records them in the link graph, and enqueues the
+ * same-site ones that are within the depth limit and have not been queued before.
+ * Links found on near-duplicate pages are enqueued with low priority.
+ */
+void extract_links(const URL *url, int page, int near_duplicate, const char *html_content) {
+    char *html_lower = html_lowercase(html_content);
+    if (!html_lower) {
+        log_message(LOG_TO_ERROR_AND_FILE, "Error: out of memory lowercasing page for URL: %s\n", url->url);
+        return;
+    }
+    LinkIdList links = {NULL, 0, 0};
+    LinkBatch batch = {NULL, 0, 0, NULL, 0, 0};
+    char link[MAX_URL_LENGTH];
+    const char *cursor = html_lower;
+    while ((cursor = html_next_link(cursor, link, sizeof(link))) != NULL) {
+        metrics_add(METRIC_LINKS_EXTRACTED, 1);
+        LOG_EVENT(LOG_DEBUG, EVENT_LINK_EXTRACTED, 1, log_string(link));
+
+        // Build new full URL
+        URL new_url;
+        UrlResolution resolution = url_resolve(options.start_url, url->url, link, new_url.url, MAX_URL_LENGTH);
+        if (resolution == URL_RESOLVED_TOO_LONG) {
+            if (LOG_ENABLED(LOG_WARN)) {
+                log_message(LOG_TO_ERROR_AND_FILE, "Skipping long URL: %s\n", link);
+            }
+            continue;
+        }
+        record_link(&links, new_url.url); // Off-site links are part of the graph but not crawled
+        if (resolution == URL_RESOLVED_OFFSITE) {
+            continue;
+        }
+        if (url_has_skipped_extension(new_url.url)) {
+            metrics_add(METRIC_LINKS_SKIPPED, 1); // An image, archive or the like: never HTML
+            continue;
+        }
+        if (url->depth + 1 >= options.max_depth) {
+            continue;
+        }
+        if (link_batch_add(&batch, new_url.url) != 0) {
+            log_message(LOG_TO_ERROR_AND_FILE, "Error: out of memory collecting links of URL: %s\n", url->url);
+        }
+    }
+    if (batch.count > 0) {
+        queue_links(&batch, url->depth + 1, near_duplicate ? URL_PRIORITY_LOW : URL_PRIORITY_NORMAL, page);
+    }
+    uint32_t source_id = url_table_intern(&url_table, url->url);
+    if (source_id != URL_ID_NONE && graph_add_edges(source_id, links.ids, links.count) != 0) {
+        log_message(LOG_TO_ERROR_AND_FILE, "Error: failed to record links of URL: %s\n", url->url);
+    }
+    free(links.ids);
+    free(batch.text);
+    free(batch.offsets);
+    free(html_lower);
+}
+
+/**
+ * Hands a page to the next stage through a bounded queue, waiting while that stage is
+ * behind. `gauge` tracks the queue's depth. Returns 0 on success, -1 if the queue is closed.
+ */
+static int hand_off(StageQueue *queue, MetricGauge gauge, PageTask *task, const char *span) {
+    uint64_t wait_start = trace_now();
+    metrics_gauge_add(gauge, 1);
+    int result = stage_queue_push(queue, task);
+    if (result != 0) {
+        metrics_gauge_add(gauge, -1);
+    }
+    trace_span(span, "queue", wait_start, trace_now(), task->page);
+    return result;
+}
+
+/**
+ * Takes the next page from a stage's input queue, waiting while it is empty.
+ * Returns NULL once the queue is closed and drained.
+ */
+static PageTask *take_task(StageQueue *queue, MetricGauge gauge, const char *span) {
+    uint64_t wait_start = trace_now();
+    PageTask *task = stage_queue_pop(queue);
+    trace_span(span, "queue", wait_start, trace_now(), TRACE_NO_PAGE);
+    if (task) {
+        metrics_gauge_add(gauge, -1);
+    }
+    return task;
+}
+
+/**
+ * Tells whether a transfer outcome means its host is overloaded: a 429 or 503 response,
+ * a timeout, or a connection that was refused or dropped.
+ */
+static HostResponse classify_response(CURLcode res, long status) {
+    switch (res) {
+    case CURLE_OK:
+        return status == 429 || status == 503 ? HOST_RESPONSE_OVERLOADED : HOST_RESPONSE_OK;
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_GOT_NOTHING:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+        return HOST_RESPONSE_OVERLOADED;
+    default:
+        return HOST_RESPONSE_OK;
+    }
+}
+
+/**
+ * Tells whether an HTTP status is an error response (4xx or 5xx). Its body describes the
+ * error rather than the page, so it is counted as a failed fetch and never stored.
+ */
+static int is_error_status(long status) {
+    return status >= 400;
+}
+
+/**
+ * Tells whether a fetch may succeed if tried again later: a timeout, a connection that
+ * was refused, reset or dropped, a transfer cut short, or a response saying the server
+ * is temporarily unable to answer (408, 429, 502, 503, 504). Other 5xx responses, like a
+ * plain 500, usually come back the same however often the page is asked for.
+ */
+static int is_transient_failure(CURLcode res, long status) {
+    switch (res) {
+    case CURLE_OK:
+        return status == 408 || status == 429 || status == 502 || status == 503 || status == 504;
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_GOT_NOTHING:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_PARTIAL_FILE:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Delay before retry number `attempt` (0 = first): exponential backoff from
+ * RETRY_BASE_DELAY_MS capped at RETRY_MAX_DELAY_MS, of which a random half is jitter so
+ * URLs that failed together (say, while their host was down) are not retried together.
+ */
+static uint64_t retry_delay_ms(int attempt) {
+    static _Atomic uint64_t jitter_state = 0x853c49e6748fea9bULL;
+    uint64_t delay = RETRY_MAX_DELAY_MS;
+    if (attempt < 16 && ((uint64_t)RETRY_BASE_DELAY_MS << attempt) < delay) {
+        delay = (uint64_t)RETRY_BASE_DELAY_MS << attempt;
+    }
+    // SplitMix64 over a shared counter: cheap, thread-safe, and good enough for jitter
+    uint64_t z = atomic_fetch_add(&jitter_state, 0x9e3779b97f4a7c15ULL) + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return delay / 2 + z % (delay / 2 + 1);
+}
+
+/**
+ * Schedules another fetch of `url` after a transient failure, unless it has used up its
+ * retries. The URL stays pending until the retry thread queues it again. Returns 1 if
+ * a retry was scheduled, 0 if the failure is final.
+ */
+static int schedule_retry(const URL *url, CURLcode res, long status) {
+    if (url->attempt >= retry_limit || !is_transient_failure(res, status)) {
+        return 0;
+    }
+    RetryTask *task = malloc(sizeof(RetryTask));
+    if (!task) {
+        return 0;
+    }
+    task->url = *url;
+    task->url.attempt++;
+    uint64_t delay = retry_delay_ms(url->attempt);
+    metrics_add(METRIC_FETCH_RETRIES, 1);
+    LOG_EVENT(LOG_INFO, EVENT_FETCH_RETRY, 5, log_string(url->url), res, status, task->url.attempt, delay);
+    timer_wheel_add(&retryWheel, &task->timer, delay);
+    return 1;
+}
+
+/**
+ * Waits while fetch thread `index` is outside the active fetch threads, or until the
+ * crawl is done.
+ */
+static void wait_for_fetch_slot(int index) {
+    if (index < atomic_load(&fetch_limit)) {
+        return;
+    }
+    uint64_t wait_start = trace_now();
+    MUTEX_LOCK(&fetch_limit_lock);
+    while (index >= atomic_load(&fetch_limit) && !atomic_load(&urlQueue.done)) {
+        COND_WAIT(&fetch_limit_cond, &fetch_limit_lock);
+    }
+    MUTEX_UNLOCK(&fetch_limit_lock);
+    trace_span("fetch slot wait", "queue", wait_start, trace_now(), TRACE_NO_PAGE);
+}
+
+/**
+ * Sets how many fetch threads are active, waking the ones that become active.
+ */
+static void set_fetch_limit(int limit) {
+    MUTEX_LOCK(&fetch_limit_lock);
+    atomic_store(&fetch_limit, limit);
+    pthread_cond_broadcast(&fetch_limit_cond);
+    MUTEX_UNLOCK(&fetch_limit_lock);
+}
+
+/**
+ * Fetch stage thread: dequeues URLs from the frontier, downloads them, and hands every
+ * successfully fetched page to the parse stage. Fetch threads only wait on the network,
+ * so there can be many more of them than CPUs; `arg` is the thread's number, and only
+ * threads numbered below the current fetch limit take URLs.
  */
 void *fetchURL(void *arg) {
     static int page_counter = 1;
     static pthread_mutex_t counter_lock = PTHREAD_MUTEX_INITIALIZER;
+    int index = (int)(intptr_t)arg;
+    trace_thread_name("fetcher");
 
     while (1) {
+        wait_for_fetch_slot(index);
+        uint64_t wait_start = trace_now();
         URL url = dequeue(&urlQueue);
+        trace_span("dequeue wait", "queue", wait_start, trace_now(), TRACE_NO_PAGE);
         if (url.url[0] == '\0') {
             break; // Exit if no more URLs and done flag set
         }
-        pthread_mutex_lock(&print_lock);
-        printf("Fetching URL: %s (Depth: %d)\n", url.url, url.depth);
-        fprintf(logFile, "Fetching URL: %s (Depth: %d)\n", url.url, url.depth);
-        fflush(logFile);
-        pthread_mutex_unlock(&print_lock);
-
-        if (url.depth < MAX_DEPTH) {
-            CURL *curl;
-            CURLcode res;
-            curl = curl_easy_init();
-            if (curl) {
-                pthread_mutex_lock(&print_lock);
-                printf("Attempting to fetch URL: %s\n", url.url);
-                fprintf(logFile, "Attempting to fetch URL: %s\n", url.url);
-                fflush(logFile);
-                pthread_mutex_unlock(&print_lock);
-                curl_easy_setopt(curl, CURLOPT_URL, url.url);
-                curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-                curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/91.0.4472.124 Safari/537.36");
-                curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-                char *html_content = NULL;
-                curl_easy_setopt(curl, CURLOPT_WRITEDATA, &html_content);
-                res = curl_easy_perform(curl);
-                if (res == CURLE_OK && html_content) {
-                    int current_page;
-                    pthread_mutex_lock(&counter_lock);
-                    current_page = page_counter++;
-                    pthread_mutex_unlock(&counter_lock);
-                    pthread_mutex_lock(&print_lock);
-                    printf("Processing page_%d for URL: %s\n", current_page, url.url);
-                    fprintf(logFile, "Processing page_%d for URL: %s\n", current_page, url.url);
-                    fflush(logFile);
-                    pthread_mutex_unlock(&print_lock);
-
-                    // Save the URL to urls.txt
-                    // Save URL and page contents
-                    save_url_to_file(url.url);
-
-                    save_html(html_content, current_page, url.url);
-                    word_finder(html_content, current_page, url.url);
-
-                    // Extract and handle links
-                    char *html_lower = strdup(html_content);
-                    if (!html_lower) {
-                        pthread_mutex_lock(&print_lock);
-                        fprintf(stderr, "Error: strdup failed for html_lower\n");
-                        fprintf(logFile, "Error: strdup failed for html_lower\n");
-                        fflush(logFile);
-                        pthread_mutex_unlock(&print_lock);
-                    } else {
-                        for (char *p = html_lower; *p; ++p) {
-                            *p = tolower(*p);
-                        }
-                        char *start = html_lower;
-                        while (start && (start = strstr(start, "<a href=\"")) != NULL) {
-                            start += strlen("<a href=\"");
-                            char *end = strstr(start, "\"");
-                            if (end) {
-                                int length = end - start;
-                                char link[MAX_URL_LENGTH];
-                                if (length >= MAX_URL_LENGTH) {
-                                    start = end + 1;
-                                    continue;
-                                }
-                                strncpy(link, start, length);
-                                link[length] = '\0';
-
-                                pthread_mutex_lock(&print_lock);
-                                printf("Extracted Link: %s\n", link);
-                                fprintf(logFile, "Extracted Link: %s\n", link);
-                                fflush(logFile);
-                                pthread_mutex_unlock(&print_lock);
-
-                                // Build new full URL
-                                URL new_url;
-                                char base_domain[MAX_URL_LENGTH];
-                                char relative_base[MAX_URL_LENGTH];
-                                strncpy(base_domain, BASE_URL, MAX_URL_LENGTH);
-
-                                // Extract base domain by truncating at the third slash
-                                char *third_slash = base_domain;
-                                int slash_count = 0;
-                                for (char *p = base_domain; *p; ++p) {
-                                    if (*p == '/') {
-                                        slash_count++;
-                                        if (slash_count == 3) {
-                                            third_slash = p;
-                                            break;
-                                        }
-                                    }
-                                }
-                                if (slash_count >= 3) {
-                                    *third_slash = '\0';
-                                }
-
-                                // Ensure base_domain ends with a '/'
-                                size_t base_len = strlen(base_domain);
-                                if (base_domain[base_len - 1] != '/') {
-                                    if (base_len + 1 < MAX_URL_LENGTH) {
-                                        base_domain[base_len] = '/';
-                                        base_domain[base_len + 1] = '\0';
-                                    }
-                                }
-
-                                // Compute the relative base from the current URL
-                                // Calculate relative base
-                                strncpy(relative_base, url.url, MAX_URL_LENGTH);
-                                char *last_slash = strrchr(relative_base, '/');
-                                if (last_slash) {
-                                    *last_slash = '\0'; // Remove the last component (e.g., index.html)
-                                }
-
-                                // Handle absolute vs relative URLs
-                                if (strncmp(link, "http", 4) == 0) {
-                                    if (strlen(link) < MAX_URL_LENGTH) {
-                                        if (strncmp(link, base_domain, strlen(base_domain)) != 0) {
-                                            start = end + 1;
-                                            continue;
-                                        }
-                                        strncpy(new_url.url, link, MAX_URL_LENGTH);
-                                    } else {
-                                        pthread_mutex_lock(&print_lock);
-                                        fprintf(stderr, "Skipping long URL: %s\n", link);
-                                        fprintf(logFile, "Skipping long URL: %s\n", link);
-                                        fflush(logFile);
-                                        pthread_mutex_unlock(&print_lock);
-                                        start = end + 1;
-                                        continue;
-                                    }
-                                } else {
-                                    // Handle relative URLs
-                                    if (strncmp(link, "../", 3) == 0) {
-                                        // Resolve ../ by removing the last directory from relative_base
-                                        char temp_base[MAX_URL_LENGTH];
-                                        strncpy(temp_base, relative_base, MAX_URL_LENGTH);
-                                        char *second_last_slash = strrchr(temp_base, '/');
-                                        if (second_last_slash) {
-                                            *second_last_slash = '\0';
-                                        }
-                                        snprintf(new_url.url, MAX_URL_LENGTH, "%s/%s", temp_base, link + 3);
-                                    } else {
-                                        snprintf(new_url.url, MAX_URL_LENGTH, "%s/%s", base_domain, link);
-                                    }
-                                }
-                                new_url.depth = url.depth + 1;
-
-                                if (new_url.depth >= MAX_DEPTH) {
-                                    start = end + 1;
-                                    continue;
-                                }
-
-                                // Check if URL already visited
-                                pthread_mutex_lock(&visited_lock);
-                                int is_visited = 0;
-                                for (int i = 0; i < visited_count; i++) {
-                                    if (visited_urls[i] && strcmp(visited_urls[i], new_url.url) == 0) {
-                                        is_visited = 1;
-                                        break;
-                                    }
-                                }
-                                if (!is_visited && visited_count < MAX_URL_LENGTH) {
-                                    visited_urls[visited_count] = strdup(new_url.url);
-                                    visited_count++;
-                                }
-                                pthread_mutex_unlock(&visited_lock);
-                                if (is_visited) {
-                                    start = end + 1;
-                                    continue;
-                                }
-
-                                // Enqueue new URL
-                                pthread_mutex_lock(&urls_per_depth_lock);
-                                if (urls_per_depth[new_url.depth] >= MAX_URLS_PER_DEPTH) {
-                                    pthread_mutex_unlock(&urls_per_depth_lock);
-                                    start = end + 1;
-                                    continue;
-                                }
-                                urls_per_depth[new_url.depth]++;
-                                pthread_mutex_unlock(&urls_per_depth_lock);
-
-                                enqueue(&urlQueue, &new_url);
-                                start = end + 1;
-                            }
-                        }
-                        free(html_lower);
-                    }
-                    pthread_mutex_lock(&print_lock);
-                    printf("Successfully processed URL: %s\n", url.url);
-                    fprintf(logFile, "Successfully processed URL: %s\n", url.url);
-                    fflush(logFile);
-                    pthread_mutex_unlock(&print_lock);
+        LOG_EVENT(LOG_INFO, EVENT_FETCH_START, 2, log_string(url.url), url.depth);
+
+        int handed_off = 0;
+        int retrying = 0;
+        if (url.depth < options.max_depth) {
+            PageBuffer page = {NULL, 0, 0, 0, (size_t)options.max_body_size, 0, NULL, {0}};
+            fingerprint_init(&page.fingerprint);
+            uint64_t host_wait_start = trace_now();
+            HostState *host = host_acquire(url.url);
+            trace_span("host wait", "idle", host_wait_start, trace_now(), TRACE_NO_PAGE);
+            StageTimer timer;
+            stage_timer_start(&timer);
+            long status;
+            FetchTimings timings;
+            CURLcode res = fetch_page(url.url, &page, &status, &timings);
+            // A response rejected by its headers was aborted on purpose: judge it by its status
+            CURLcode outcome = page.rejected ? CURLE_OK : res;
+            host_release(host, classify_response(outcome, status), timings.total);
+            uint64_t fetch_start = timer.wall;
+            stage_timer_lap(&timer, STAGE_FETCH);
+            uint64_t fetch_end = timer.wall;
+            metrics_add(METRIC_BYTES_DOWNLOADED, page.length);
+            metrics_add(METRIC_WIRE_BYTES, page.wire_length);
+            if (schedule_retry(&url, outcome, status)) {
+                retrying = 1;
+            } else if (page.rejected) {
+                metrics_add(METRIC_SKIPPED_RESPONSES, 1);
+                LOG_EVENT(LOG_INFO, EVENT_FETCH_SKIPPED, 2, log_string(url.url), log_string(page.rejected));
+            } else if (res == CURLE_OK && is_error_status(status)) {
+                // Includes transient failures whose retries are used up
+                metrics_add(METRIC_FETCH_ERRORS, 1);
+                LOG_EVENT(LOG_WARN, EVENT_FETCH_HTTP_ERROR, 2, log_string(url.url), status);
+            } else if (res == CURLE_OK && page.data) {
+                metrics_add(METRIC_PAGES_FETCHED, 1);
+                int current_page;
+                MUTEX_LOCK(&counter_lock);
+                current_page = page_counter++;
+                MUTEX_UNLOCK(&counter_lock);
+                trace_span("fetch", "stage", fetch_start, fetch_end, current_page); // Page number is only known now
+                LOG_EVENT(LOG_INFO, EVENT_PAGE_PROCESSING, 2, current_page, log_string(url.url));
+                if (page.truncated) {
+                    metrics_add(METRIC_TRUNCATED_PAGES, 1);
+                    LOG_EVENT(LOG_WARN, EVENT_PAGE_TRUNCATED, 3, current_page, page.length, log_string(url.url));
+                }
+
+                PageTask *task = malloc(sizeof(PageTask));
+                if (!task) {
+                    log_message(LOG_TO_ERROR_AND_FILE, "Error: out of memory queueing page_%d, URL: %s\n", current_page, url.url);
                 } else {
-                    pthread_mutex_lock(&print_lock);
-                    printf("Failed to fetch URL: %s (%s)\n", url.url, curl_easy_strerror(res));
-                    fprintf(logFile, "Failed to fetch URL: %s (%s)\n", url.url, curl_easy_strerror(res));
-                    fflush(logFile);
-                    pthread_mutex_unlock(&print_lock);
+                    *task = (PageTask){url, current_page, page, fingerprint_final(&page.fingerprint), -1, -1, 0};
+                    uint64_t wait_start = trace_now();
+                    metrics_gauge_add(METRIC_PARSE_QUEUE_DEPTH, 1);
+                    handed_off = work_pool_submit(&parsePool, task) == 0;
+                    trace_span("parse queue full", "queue", wait_start, trace_now(), current_page);
+                    if (!handed_off) {
+                        metrics_gauge_add(METRIC_PARSE_QUEUE_DEPTH, -1);
+                        free(task);
+                    }
                 }
-                curl_easy_cleanup(curl);
-                free(html_content);
+            } else {
+                metrics_add(METRIC_FETCH_ERRORS, 1);
+                LOG_EVENT(LOG_WARN, EVENT_FETCH_FAILED, 3, log_string(url.url), res, log_string(curl_easy_strerror(res)));
             }
+            if (!handed_off) {
+                free(page.data);
+            }
+        }
+        if (!handed_off && !retrying) {
+            finish_url(&urlQueue);
         }
+    }
+    return NULL;
+}
 
-        // Small sleep to prevent aggressive resource usage
-        struct timespec ts = {0, 100000000};
-        nanosleep(&ts, NULL);
+/**
+ * Retry thread: drives the retry timer wheel, putting URLs back into the URL queue as
+ * their backoff expires, so no fetch thread sleeps through a backoff. Exits once the
+ * wheel is closed at the end of the crawl.
+ */
+void *retryFetches(void *arg) {
+    (void)arg;
+    trace_thread_name("retry");
+    TimerEntry *expired;
+    while ((expired = timer_wheel_wait(&retryWheel)) != NULL) {
+        while (expired) {
+            RetryTask *task = (RetryTask *)expired;
+            expired = expired->next;
+            requeue(&urlQueue, &task->url);
+            free(task);
+        }
+    }
+    return NULL;
+}
 
-        if (isEmpty(&urlQueue)) {
-            pthread_mutex_lock(&done_lock);
-            done = 1;
-            pthread_cond_broadcast(&urlQueue.cond);
-            pthread_mutex_unlock(&done_lock);
+/**
+ * Parse stage thread: claims each page's body in the content store, counts words and
+ * checks for near-duplicates (exact duplicates were already analyzed when their body was
+ * first seen, and count as near-duplicates), extracts and enqueues links, then hands the
+ * page to the write stage. This is the CPU-bound stage, sized by core count; `arg` is the
+ * thread's worker number in the parse pool.
+ */
+void *parsePage(void *arg) {
+    int worker = (int)(intptr_t)arg;
+    trace_thread_name("parser");
+    while (1) {
+        uint64_t wait_start = trace_now();
+        PageTask *task = work_pool_next(&parsePool, worker);
+        trace_span("parse queue wait", "queue", wait_start, trace_now(), TRACE_NO_PAGE);
+        if (!task) {
+            break; // Pool closed and drained
+        }
+        metrics_gauge_add(METRIC_PARSE_QUEUE_DEPTH, -1);
+        StageTimer timer;
+        stage_timer_start(&timer);
+        task->is_new = claim_html(task);
+        if (task->is_new == 0) {
+            metrics_add(METRIC_DUPLICATE_PAGES, 1);
+        }
+        end_stage(&timer, STAGE_DEDUP, task->page);
+        int near_duplicate = 1;
+        if (task->is_new != 0) {
+            task->simhash = word_finder(task->body.data, task->page, task->url.url);
+            end_stage(&timer, STAGE_WORDS, task->page);
+            near_duplicate = flag_near_duplicate(task->simhash, task->page, task->url.url);
+            if (task->is_new > 0) {
+                store_set_body_simhash(task->body_id, task->simhash);
+            }
+        } else {
+            task->simhash = store_body_simhash(task->body_id); // Waits while the page that claimed the body analyzes it
+        }
+        end_stage(&timer, STAGE_DEDUP, task->page);
+
+        extract_links(&task->url, task->page, near_duplicate, task->body.data);
+        end_stage(&timer, STAGE_PARSE, task->page);
+        LOG_EVENT(LOG_INFO, EVENT_PAGE_DONE, 1, log_string(task->url.url));
+
+        // The page's links are queued, so the URL is done once the write stage has it
+        if (hand_off(&writeQueue, METRIC_WRITE_QUEUE_DEPTH, task, "write queue full") != 0) {
+            free(task->body.data);
+            free(task);
+        }
+        finish_url(&urlQueue);
+    }
+    return NULL;
+}
+
+/**
+ * Write stage thread: appends each page to urls.txt and saves its body and page record
+ * in the page store.
+ */
+void *writePage(void *arg) {
+    (void)arg;
+    trace_thread_name("writer");
+    PageTask *task;
+    while ((task = take_task(&writeQueue, METRIC_WRITE_QUEUE_DEPTH, "write queue wait")) != NULL) {
+        StageTimer timer;
+        stage_timer_start(&timer);
+        save_url_to_file(task->url.url);
+        if (save_html(task) == 0 && task->body_id >= 0 &&
+            store_add_page(task->page, task->body_id, &task->fp, task->simhash, task->body.truncated, task->url.url) != 0) {
+            log_message(LOG_TO_STDERR, "Error writing to page store: %s\n", strerror(errno));
+            log_message(LOG_TO_FILE, "Error recording page_%d in page store for URL: %s\n", task->page, task->url.url);
+        }
+        end_stage(&timer, STAGE_STORE, task->page);
+        free(task->body.data);
+        free(task);
+    }
+    return NULL;
+}
+
+/**
+ * Logs one stats line covering the time between two snapshots: pages and bytes per second
+ * (decoded, and as received before content decoding), queue depths (frontier, then pages waiting to be parsed and written), error rate and
+ * fetch latency percentiles.
+ */
+void log_stats(const char *label, const MetricsSnapshot *now, const MetricsSnapshot *before) {
+    double elapsed = now->uptime - before->uptime;
+    if (elapsed <= 0) {
+        elapsed = 1e-9;
+    }
+    uint64_t pages = now->counters[METRIC_PAGES_FETCHED] - before->counters[METRIC_PAGES_FETCHED];
+    uint64_t errors = now->counters[METRIC_FETCH_ERRORS] - before->counters[METRIC_FETCH_ERRORS];
+    uint64_t retries = now->counters[METRIC_FETCH_RETRIES] - before->counters[METRIC_FETCH_RETRIES];
+    uint64_t bytes = now->counters[METRIC_BYTES_DOWNLOADED] - before->counters[METRIC_BYTES_DOWNLOADED];
+    uint64_t wire_bytes = now->counters[METRIC_WIRE_BYTES] - before->counters[METRIC_WIRE_BYTES];
+    uint64_t attempts = pages + errors;
+
+    // Latency percentiles of the fetches finished in this interval only
+    static MetricsHistogram interval;
+    const MetricsHistogram *total_now = &now->histograms[METRIC_TOTAL_TIME];
+    const MetricsHistogram *total_before = &before->histograms[METRIC_TOTAL_TIME];
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        interval.buckets[b] = total_now->buckets[b] - total_before->buckets[b];
+    }
+    interval.max = total_now->max;
+
+    log_message(LOG_TO_CONSOLE_AND_FILE,
+                "%s: %llu pages (%.1f pages/s), %.1f KB/s (%.1f KB/s on the wire), queue %lld (parse %lld, write %lld), %llu errors (%.1f%%), "
+                "%llu retries, fetch p50 %.1f ms p99 %.1f ms\n",
+                label, (unsigned long long)pages, pages / elapsed, bytes / 1024.0 / elapsed, wire_bytes / 1024.0 / elapsed,
+                (long long)now->gauges[METRIC_QUEUE_DEPTH], (long long)now->gauges[METRIC_PARSE_QUEUE_DEPTH],
+                (long long)now->gauges[METRIC_WRITE_QUEUE_DEPTH], (unsigned long long)errors,
+                attempts ? 100.0 * errors / attempts : 0.0, (unsigned long long)retries,
+                metrics_percentile(&interval, 50) / 1000.0, metrics_percentile(&interval, 99) / 1000.0);
+}
+
+/**
+ * Logs where the crawler threads spent their time between two snapshots, per stage:
+ * elapsed time, its share of all timed work, and the CPU time behind it. A stage with
+ * much more elapsed than CPU time is waiting (on the network, the disk or a lock).
+ */
+void log_stages(const char *label, const MetricsSnapshot *now, const MetricsSnapshot *before) {
+    uint64_t wall[STAGE_COUNT], total = 0;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        wall[i] = now->stage_wall_ns[i] - before->stage_wall_ns[i];
+        total += wall[i];
+    }
+    char line[512];
+    int length = snprintf(line, sizeof(line), "%s:", label);
+    for (int i = 0; i < STAGE_COUNT && length < (int)sizeof(line); i++) {
+        length += snprintf(line + length, sizeof(line) - length, "%s %s %.1f ms (%.1f%%, cpu %.1f ms)",
+                           i ? "," : "", metrics_stage_name(i), wall[i] / 1e6, total ? 100.0 * wall[i] / total : 0.0,
+                           (now->stage_cpu_ns[i] - before->stage_cpu_ns[i]) / 1e6);
+    }
+    log_message(LOG_TO_CONSOLE_AND_FILE, "%s\n", line);
+}
+
+/**
+ * Stats thread: logs a stats line every options.stats_interval seconds until the crawl ends.
+ */
+void *report_stats(void *arg) {
+    (void)arg;
+    MetricsSnapshot *previous = calloc(1, sizeof(MetricsSnapshot));
+    MetricsSnapshot *current = malloc(sizeof(MetricsSnapshot));
+    if (!previous || !current) {
+        free(previous);
+        free(current);
+        return NULL;
+    }
+    MUTEX_LOCK(&stats_lock);
+    while (!stats_done) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += options.stats_interval;
+        while (!stats_done && COND_TIMEDWAIT(&stats_cond, &stats_lock, &deadline) == 0) {
+            // Woken early (or spuriously) without the crawl ending; keep waiting
+        }
+        if (stats_done) {
             break;
         }
+        MUTEX_UNLOCK(&stats_lock);
+        metrics_snapshot(current);
+        if (LOG_ENABLED(LOG_INFO)) {
+            log_stats("Stats", current, previous);
+            log_stages("Stage time", current, previous);
+        }
+        MetricsSnapshot *swap = previous;
+        previous = current;
+        current = swap;
+        MUTEX_LOCK(&stats_lock);
     }
+    MUTEX_UNLOCK(&stats_lock);
+    free(previous);
+    free(current);
     return NULL;
 }
 
 /**
- * Main crawling function: starts threads, initializes the queue,
- * enqueues the starting URL, and waits for all threads to complete.
+ * Returns the CPU time used by all threads of the process so far, in seconds.
+ */
+static double process_cpu_seconds(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Worker controller thread, run when the fetch threads are sized automatically. Every
+ * CONTROL_INTERVAL_MS it compares the URL backlog with the active fetch threads and grows
+ * them by a quarter while URLs are waiting, unless the parse stage is falling behind (its
+ * queue is 3/4 full or the CPUs are 90% busy), in which case it shrinks them by a quarter,
+ * or fetch latency has doubled over the fastest interval seen, in which case it holds.
+ * `arg` points to the number of fetch threads started, the most it can activate.
+ */
+void *control_workers(void *arg) {
+    int max_limit = *(const int *)arg;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    MetricsSnapshot *previous = calloc(1, sizeof(MetricsSnapshot));
+    MetricsSnapshot *current = malloc(sizeof(MetricsSnapshot));
+    if (!previous || !current) {
+        free(previous);
+        free(current);
+        return NULL;
+    }
+    metrics_snapshot(previous);
+    double previous_cpu = process_cpu_seconds();
+    double best_latency = 0; // Lowest mean fetch latency over an interval, in microseconds
+    MUTEX_LOCK(&stats_lock);
+    while (!stats_done) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += CONTROL_INTERVAL_MS / 1000;
+        deadline.tv_nsec += (CONTROL_INTERVAL_MS % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (!stats_done && COND_TIMEDWAIT(&stats_cond, &stats_lock, &deadline) == 0) {
+            // Woken early (or spuriously) without the crawl ending; keep waiting
+        }
+        if (stats_done) {
+            break;
+        }
+        MUTEX_UNLOCK(&stats_lock);
+
+        metrics_snapshot(current);
+        double cpu = process_cpu_seconds();
+        double elapsed = current->uptime - previous->uptime;
+        double busy = elapsed > 0 && cpus > 0 ? (cpu - previous_cpu) / (elapsed * cpus) : 0;
+        const MetricsHistogram *now = &current->histograms[METRIC_TOTAL_TIME];
+        const MetricsHistogram *before = &previous->histograms[METRIC_TOTAL_TIME];
+        double latency = now->count > before->count ? (double)(now->sum - before->sum) / (now->count - before->count) : 0;
+        if (latency > 0 && (best_latency == 0 || latency < best_latency)) {
+            best_latency = latency;
+        }
+        int64_t backlog = current->gauges[METRIC_QUEUE_DEPTH];
+        int64_t parse_backlog = current->gauges[METRIC_PARSE_QUEUE_DEPTH];
+
+        int limit = atomic_load(&fetch_limit);
+        int new_limit = limit;
+        if (parse_backlog >= STAGE_QUEUE_CAPACITY * 3 / 4 || busy >= 0.9) {
+            new_limit = limit - limit / 4; // Fetching outpaces parsing
+        } else if (latency > 2 * best_latency) {
+            // The sites are slowing down; more concurrent fetches would not help
+        } else if (backlog > limit) {
+            new_limit = limit + (limit / 4 > 1 ? limit / 4 : 1);
+        }
+        new_limit = new_limit < 1 ? 1 : new_limit > max_limit ? max_limit : new_limit;
+        if (new_limit != limit) {
+            set_fetch_limit(new_limit);
+            if (LOG_ENABLED(LOG_DEBUG)) {
+                log_message(LOG_TO_FILE, "Fetch threads: %d -> %d (queue %lld, parse queue %lld, CPU %.0f%%, fetch %.1f ms)\n",
+                            limit, new_limit, (long long)backlog, (long long)parse_backlog, busy * 100, latency / 1000);
+            }
+        }
+
+        MetricsSnapshot *swap = previous;
+        previous = current;
+        current = swap;
+        previous_cpu = cpu;
+        MUTEX_LOCK(&stats_lock);
+    }
+    MUTEX_UNLOCK(&stats_lock);
+    free(previous);
+    free(current);
+    return NULL;
+}
+
+/**
+ * Starts `count` threads running `function`, each given its index as argument.
+ * Returns how many were started.
+ */
+static int start_pool(pthread_t *pool, int count, void *(*function)(void *)) {
+    int started = 0;
+    while (started < count && pthread_create(&pool[started], NULL, function, (void *)(intptr_t)started) == 0) {
+        started++;
+    }
+    return started;
+}
+
+static void join_pool(pthread_t *pool, int count) {
+    for (int i = 0; i < count; i++) {
+        pthread_join(pool[i], NULL);
+    }
+}
+
+/**
+ * Main crawling function: initializes the queues, enqueues the starting URL, and runs the
+ * crawl as a pipeline of three thread pools connected by bounded queues: fetch threads
+ * download pages, parse threads analyze them and enqueue their links, and write threads
+ * store them. Returns once every queued URL has been processed and stored.
  */
 void crawl() {
     URL start;
-    strncpy(start.url, BASE_URL, MAX_URL_LENGTH);
+    strncpy(start.url, options.start_url, MAX_URL_LENGTH - 1);
+    start.url[MAX_URL_LENGTH - 1] = '\0';
     start.depth = 0;
-    initQueue(&urlQueue);
+    start.priority = URL_PRIORITY_NORMAL;
+    start.attempt = 0;
+    if (initQueue(&urlQueue) != 0) {
+        log_message(LOG_TO_ERROR_AND_FILE, "Error: out of memory starting the crawl\n");
+        return;
+    }
+    if (host_limits_init() != 0) {
+        log_message(LOG_TO_ERROR_AND_FILE, "Error: out of memory starting the crawl\n");
+        destroyQueue(&urlQueue);
+        return;
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        cpus = 1;
+    }
+    int parse_threads = options.parse_threads;
+    if (parse_threads <= 0) {
+        parse_threads = (int)(cpus < MAX_STAGE_THREADS ? cpus : MAX_STAGE_THREADS);
+    }
+    // Fetch threads: a fixed number if given, else a pool the worker controller activates as needed
+    int fetch_threads = options.fetch_threads;
+    int active_fetchers = fetch_threads;
+    if (fetch_threads <= 0) {
+        fetch_threads = (int)(cpus * FETCH_THREADS_PER_CPU < MAX_STAGE_THREADS ? cpus * FETCH_THREADS_PER_CPU : MAX_STAGE_THREADS);
+        active_fetchers = (int)(cpus * FETCH_SLOTS_PER_CPU < fetch_threads ? cpus * FETCH_SLOTS_PER_CPU : fetch_threads);
+    }
+    atomic_store(&fetch_limit, active_fetchers);
+    pthread_t *fetchers = malloc(fetch_threads * sizeof(pthread_t));
+    pthread_t *parsers = malloc(parse_threads * sizeof(pthread_t));
+    pthread_t *writers = malloc(options.write_threads * sizeof(pthread_t));
+    if (!fetchers || !parsers || !writers || work_pool_init(&parsePool, parse_threads, STAGE_QUEUE_CAPACITY) != 0) {
+        log_message(LOG_TO_ERROR_AND_FILE, "Error: out of memory starting the crawl\n");
+        free(fetchers);
+        free(parsers);
+        free(writers);
+        destroyQueue(&urlQueue);
+        host_limits_destroy();
+        return;
+    }
+    if (stage_queue_init(&writeQueue, STAGE_QUEUE_CAPACITY, "write queue") != 0) {
+        log_message(LOG_TO_ERROR_AND_FILE, "Error: out of memory starting the crawl\n");
+        work_pool_destroy(&parsePool);
+        free(fetchers);
+        free(parsers);
+        free(writers);
+        destroyQueue(&urlQueue);
+        host_limits_destroy();
+        return;
+    }
+    // Retries are off when replaying, since a replayed failure would only fail again
+    retry_limit = options.replay_path ? 0 : options.fetch_retries;
+    pthread_t retry_thread;
+    int retry_running = 0;
+    if (retry_limit > 0 && timer_wheel_init(&retryWheel, RETRY_TICK_MS) == 0) {
+        retry_running = pthread_create(&retry_thread, NULL, retryFetches, NULL) == 0;
+        if (!retry_running) {
+            timer_wheel_destroy(&retryWheel);
+        }
+    }
+    if (!retry_running) {
+        retry_limit = 0;
+    }
     enqueue(&urlQueue, &start);
 
-    for (int i = 0; i < MAX_THREADS; i++) {
-        pthread_create(&threads[i], NULL, fetchURL, NULL);
+    int writer_count = start_pool(writers, options.write_threads, writePage);
+    int parser_count = start_pool(parsers, parse_threads, parsePage);
+    int fetcher_count = start_pool(fetchers, fetch_threads, fetchURL);
+    if (fetcher_count < active_fetchers) {
+        set_fetch_limit(fetcher_count);
     }
+    if (LOG_ENABLED(LOG_INFO)) {
+        if (options.fetch_threads > 0) {
+            log_message(LOG_TO_CONSOLE_AND_FILE, "Pipeline: %d fetch, %d parse, %d write threads\n", fetcher_count,
+                        parser_count, writer_count);
+        } else {
+            log_message(LOG_TO_CONSOLE_AND_FILE, "Pipeline: %d fetch (up to %d, adjusted automatically), %d parse, %d write threads\n",
+                        atomic_load(&fetch_limit), fetcher_count, parser_count, writer_count);
+        }
+    }
+
+    pthread_t stats_thread;
+    int stats_running = options.stats_interval > 0 && pthread_create(&stats_thread, NULL, report_stats, NULL) == 0;
+    pthread_t control_thread;
+    int control_running = options.fetch_threads <= 0 &&
+                          pthread_create(&control_thread, NULL, control_workers, &fetcher_count) == 0;
+
+    // Fetch threads exit once every URL is done (none is waiting for a retry either); the
+    // later stages then drain their queues
+    join_pool(fetchers, fetcher_count);
+    if (retry_running) {
+        timer_wheel_close(&retryWheel);
+        pthread_join(retry_thread, NULL);
+        timer_wheel_destroy(&retryWheel);
+    }
+    work_pool_close(&parsePool);
+    join_pool(parsers, parser_count);
+    stage_queue_close(&writeQueue);
+    join_pool(writers, writer_count);
+    work_pool_destroy(&parsePool);
+    stage_queue_destroy(&writeQueue);
+    free(fetchers);
+    free(parsers);
+    free(writers);
+    destroyQueue(&urlQueue);
+    host_limits_destroy();
 
-    for (int i = 0; i < MAX_THREADS; i++) {
-        pthread_join(threads[i], NULL);
+    MUTEX_LOCK(&stats_lock);
+    stats_done = 1;
+    pthread_cond_broadcast(&stats_cond);
+    MUTEX_UNLOCK(&stats_lock);
+    if (stats_running) {
+        pthread_join(stats_thread, NULL);
+    }
+    if (control_running) {
+        pthread_join(control_thread, NULL);
+    }
+    if (LOG_ENABLED(LOG_INFO)) {
+        static MetricsSnapshot start, end;
+        metrics_snapshot(&end);
+        log_stats("Crawl summary", &end, &start);
+        log_stages("Stage time summary", &end, &start);
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            log_message(LOG_TO_CONSOLE_AND_FILE, "Peak memory: %ld KB\n", usage.ru_maxrss);
+        }
+    }
+}
+
+/**
+ * Computes PageRank over the link graph written at the end of the crawl
+ * and saves one score per URL id to store/pagerank.tsv.
+ */
+void rank_pages() {
+    char graph_path[256], rank_path[256];
+    snprintf(graph_path, sizeof(graph_path), "%s/%s", STORE_DIR, GRAPH_CSR_FILE);
+    snprintf(rank_path, sizeof(rank_path), "%s/%s", STORE_DIR, PAGERANK_FILE);
+    int threads = options.pagerank_threads;
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+
+    PageRankResult result;
+    if (pagerank_compute(graph_path, threads, &result) != 0 || pagerank_write(rank_path, &result, &url_table) != 0) {
+        log_message(LOG_TO_STDERR, "Error computing PageRank: %s\n", strerror(errno));
+        log_message(LOG_TO_FILE, "Error computing PageRank from %s\n", graph_path);
+    } else if (LOG_ENABLED(LOG_INFO)) {
+        log_message(LOG_TO_CONSOLE_AND_FILE, "PageRank for %llu URLs saved to %s (%d iterations, %d threads)\n",
+                    (unsigned long long)result.node_count, rank_path, result.iterations, threads);
+    }
+    pagerank_free(&result);
+}
+
+/**
+ * Parses command-line options into the global options struct.
+ * Returns 0 on success, -1 (after printing usage) on an unknown or malformed option.
+ */
+int parse_options(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--url") == 0 && i + 1 < argc) {
+            options.start_url = argv[++i];
+        } else if (strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc) {
+            options.max_depth = atoi(argv[++i]);
+            if (options.max_depth < 1 || options.max_depth > MAX_DEPTH_LIMIT) {
+                fprintf(stderr, "--max-depth must be between 1 and %d\n", MAX_DEPTH_LIMIT);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--max-urls-per-depth") == 0 && i + 1 < argc) {
+            options.max_urls_per_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fetch-threads") == 0 && i + 1 < argc) {
+            options.fetch_threads = atoi(argv[++i]);
+            if (options.fetch_threads < 1 || options.fetch_threads > MAX_STAGE_THREADS) {
+                fprintf(stderr, "--fetch-threads must be between 1 and %d\n", MAX_STAGE_THREADS);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--parse-threads") == 0 && i + 1 < argc) {
+            options.parse_threads = atoi(argv[++i]);
+            if (options.parse_threads < 1 || options.parse_threads > MAX_STAGE_THREADS) {
+                fprintf(stderr, "--parse-threads must be between 1 and %d\n", MAX_STAGE_THREADS);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--write-threads") == 0 && i + 1 < argc) {
+            options.write_threads = atoi(argv[++i]);
+            if (options.write_threads < 1 || options.write_threads > MAX_STAGE_THREADS) {
+                fprintf(stderr, "--write-threads must be between 1 and %d\n", MAX_STAGE_THREADS);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--retries") == 0 && i + 1 < argc) {
+            options.fetch_retries = atoi(argv[++i]);
+            if (options.fetch_retries < 0) {
+                fprintf(stderr, "--retries must not be negative\n");
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--connect-timeout") == 0 && i + 1 < argc) {
+            options.connect_timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            options.transfer_timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--stall-timeout") == 0 && i + 1 < argc) {
+            options.stall_timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-body-size") == 0 && i + 1 < argc) {
+            options.max_body_size = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--pagerank") == 0) {
+            options.pagerank = 1;
+        } else if (strcmp(argv[i], "--pagerank-threads") == 0 && i + 1 < argc) {
+            options.pagerank_threads = atoi(argv[++i]);
+            options.pagerank = 1;
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            if (log_set_level(argv[++i]) != 0) {
+                fprintf(stderr, "Unknown log level: %s (use error, warn, info, debug or trace)\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--log-sample") == 0 && i + 1 < argc) {
+            if (log_set_sampling(argv[++i]) != 0) {
+                fprintf(stderr, "Invalid sampling spec: %s (use EVENT=N, e.g. link_extracted=100)\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--stats-interval") == 0 && i + 1 < argc) {
+            options.stats_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            options.metrics_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            options.trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            options.record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            options.replay_path = argv[++i];
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            fprintf(stderr, "Usage: %s [--url URL] [--max-depth N] [--max-urls-per-depth N] [--pagerank] [--pagerank-threads N]\n"
+                            "       [--fetch-threads N] [--parse-threads N] [--write-threads N] [--retries N]\n"
+                            "       [--connect-timeout SECONDS] [--timeout SECONDS] [--stall-timeout SECONDS] [--max-body-size BYTES]\n"
+                            "       [--log-level LEVEL] [--log-sample EVENT=N]... [--stats-interval SECONDS]\n"
+                            "       [--metrics-port PORT] [--trace FILE] [--record FILE | --replay FILE]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (options.connect_timeout < 0 || options.transfer_timeout < 0 || options.stall_timeout < 0 ||
+        options.max_body_size < 0) {
+        fprintf(stderr, "Timeouts and --max-body-size must not be negative\n");
+        return -1;
+    }
+    if ((unsigned long)options.max_body_size > STORE_MAX_BODY_LENGTH) {
+        fprintf(stderr, "--max-body-size must be at most %lu bytes, the largest body the page store holds\n",
+                (unsigned long)STORE_MAX_BODY_LENGTH);
+        return -1;
+    }
+    if (options.max_body_size == 0) {
+        options.max_body_size = (long)STORE_MAX_BODY_LENGTH; // As large as the store allows
+    }
+    if (options.record_path && options.replay_path) {
+        fprintf(stderr, "--record and --replay cannot be used together\n");
+        return -1;
     }
+    return 0;
 }
 
 /**
  * Main function.
- * Opens log and URLs files, initializes CURL, starts crawling,
- * and cleans up all allocated resources afterward.
+ * Parses options, opens log and URLs files, initializes CURL, starts crawling,
+ * optionally ranks the crawled pages, and cleans up all allocated resources afterward.
  */
 int main(int argc, char *argv[]) {
+    if (parse_options(argc, argv) != 0) {
+        return 1;
+    }
+
     logFile = fopen(LOG_FILE, "a");
     if (!logFile) {
         perror("Error opening log file");
@@ -534,20 +1702,134 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    printf("Starting crawl with base URL: %s\n", BASE_URL);
-    fprintf(logFile, "Starting crawl with base URL: %s\n", BASE_URL);
-    fflush(logFile);
+    eventFile = fopen(EVENT_LOG_FILE, "wb");
+    if (!eventFile) {
+        perror("Error opening event log file");
+        fclose(logFile);
+        fclose(urlsFile);
+        return 1;
+    }
+
+    if (log_start(logFile, eventFile) != 0) {
+        perror("Error starting log thread");
+        fclose(logFile);
+        fclose(eventFile);
+        fclose(urlsFile);
+        return 1;
+    }
+    if (LOG_ENABLED(LOG_INFO)) {
+        log_message(LOG_TO_CONSOLE_AND_FILE, "Starting crawl with base URL: %s\n", options.start_url);
+    }
 
     memset(urls_per_depth, 0, sizeof(urls_per_depth));
-    memset(visited_urls, 0, sizeof(visited_urls));
-    visited_count = 0;
+    if ((options.record_path && recording_open(options.record_path) != 0) ||
+        (options.replay_path && replay_open(options.replay_path) != 0)) {
+        fprintf(stderr, "Error opening recording %s: %s\n", options.record_path ? options.record_path : options.replay_path,
+                strerror(errno));
+        log_stop();
+        fclose(logFile);
+        fclose(eventFile);
+        fclose(urlsFile);
+        return 1;
+    }
+    if (options.replay_path && LOG_ENABLED(LOG_INFO)) {
+        log_message(LOG_TO_CONSOLE_AND_FILE, "Replaying %zu recorded responses from %s\n", replay_count(), options.replay_path);
+    }
+    if (visited_set_init(&visited_urls, MAX_URL_LENGTH) != 0) {
+        perror("Error allocating visited set");
+        log_stop();
+        fclose(logFile);
+        fclose(eventFile);
+        fclose(urlsFile);
+        return 1;
+    }
+    if (store_open(STORE_DIR) != 0) {
+        perror("Error opening page store");
+        log_stop();
+        fclose(logFile);
+        fclose(eventFile);
+        fclose(urlsFile);
+        return 1;
+    }
+    if (simhash_index_init(&simhash_index) != 0 || url_table_init(&url_table) != 0 || graph_open(STORE_DIR) != 0) {
+        perror("Error setting up near-duplicate index and link graph");
+        store_close();
+        log_stop();
+        fclose(logFile);
+        fclose(eventFile);
+        fclose(urlsFile);
+        return 1;
+    }
     curl_global_init(CURL_GLOBAL_DEFAULT);
+    if (LOG_ENABLED(LOG_DEBUG)) {
+        const curl_version_info_data *curl_info = curl_version_info(CURLVERSION_NOW);
+        log_message(LOG_TO_CONSOLE_AND_FILE, "Content encodings accepted:%s%s%s\n",
+                    curl_info->features & CURL_VERSION_LIBZ ? " gzip deflate" : "",
+                    curl_info->features & CURL_VERSION_BROTLI ? " br" : "",
+                    curl_info->features & CURL_VERSION_ZSTD ? " zstd" : "");
+    }
+    metrics_init();
+    if (options.metrics_port > 0 && metrics_serve_start(options.metrics_port) != 0) {
+        log_message(LOG_TO_ERROR_AND_FILE, "Error starting metrics endpoint on port %d: %s\n", options.metrics_port, strerror(errno));
+    }
+    if (options.trace_path) {
+        trace_start();
+    }
     crawl();
-    for (int i = 0; i < visited_count; i++) {
-        free(visited_urls[i]);
+    if (recording_close() != 0) {
+        log_message(LOG_TO_STDERR, "Error writing recording: %s\n", strerror(errno));
+        log_message(LOG_TO_FILE, "Error writing recording %s\n", options.record_path);
+    } else if (options.record_path && LOG_ENABLED(LOG_INFO)) {
+        log_message(LOG_TO_CONSOLE_AND_FILE, "Responses recorded to %s\n", options.record_path);
+    }
+    replay_close();
+    if (options.trace_path) {
+        if (trace_write(options.trace_path) == 0) {
+            if (LOG_ENABLED(LOG_INFO)) {
+                log_message(LOG_TO_CONSOLE_AND_FILE, "Trace saved to %s\n", options.trace_path);
+            }
+        } else {
+            log_message(LOG_TO_STDERR, "Error writing trace: %s\n", strerror(errno));
+            log_message(LOG_TO_FILE, "Error writing trace to %s\n", options.trace_path);
+        }
+        trace_destroy();
+    }
+
+    // Compact the recorded links into the on-disk graph
+    uint64_t edge_count = 0;
+    if (graph_build(STORE_DIR, &url_table, &edge_count) == 0) {
+        if (LOG_ENABLED(LOG_INFO)) {
+            log_message(LOG_TO_CONSOLE_AND_FILE, "Link graph saved to %s/%s: %u URLs, %llu links\n", STORE_DIR, GRAPH_CSR_FILE,
+                        url_table_count(&url_table), (unsigned long long)edge_count);
+        }
+    } else {
+        log_message(LOG_TO_STDERR, "Error writing link graph: %s\n", strerror(errno));
+        log_message(LOG_TO_FILE, "Error writing link graph to %s/%s\n", STORE_DIR, GRAPH_CSR_FILE);
     }
+    if (options.pagerank) {
+        rank_pages();
+    }
+    visited_set_destroy(&visited_urls);
     curl_global_cleanup();
+    metrics_serve_stop();
+    metrics_destroy();
+    simhash_index_destroy(&simhash_index);
+    url_table_destroy(&url_table);
+    if (store_close() != 0) {
+        log_message(LOG_TO_STDERR, "Error writing page store index: %s\n", strerror(errno));
+        log_message(LOG_TO_FILE, "Error writing page store index %s/%s\n", STORE_DIR, STORE_PAGE_INDEX_FILE);
+    }
+#ifdef LOCK_PROFILE
+    char *lock_report = malloc(65536);
+    if (lock_report) {
+        lock_profile_report(lock_report, 65536);
+        log_message(LOG_TO_CONSOLE_AND_FILE, "%s", lock_report);
+        free(lock_report);
+    }
+#endif
+    log_stop();
     fclose(logFile);
+    fclose(eventFile);
     fclose(urlsFile);
     return 0;
 }
\ No newline at end of file
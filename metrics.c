@@ -0,0 +1,389 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like sockets and poll
+#define _POSIX_C_SOURCE 200809L
+#include "metrics.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define METRICS_RESPONSE_MAX 16384 // Largest Prometheus response
+#define METRICS_POLL_MS 200        // How often the server checks whether it should stop
+
+// Per-thread metrics. Only the owning thread writes a shard, so updates are plain
+// relaxed loads and stores; readers may see a slightly stale but never torn value.
+typedef struct MetricsShard {
+    _Atomic uint64_t counters[METRIC_COUNTER_COUNT];
+    struct {
+        _Atomic uint64_t count;
+        _Atomic uint64_t sum;
+        _Atomic uint64_t max;
+        _Atomic uint64_t buckets[METRICS_BUCKETS];
+    } histograms[METRIC_HISTOGRAM_COUNT];
+    _Atomic uint64_t stage_wall_ns[STAGE_COUNT];
+    _Atomic uint64_t stage_cpu_ns[STAGE_COUNT];
+    struct MetricsShard *next; // Next shard in the registry
+} MetricsShard;
+
+static _Atomic(MetricsShard *) shards = NULL; // Registry of all thread shards (push-only list)
+static _Thread_local MetricsShard *thread_shard = NULL;
+static _Atomic int64_t gauges[METRIC_GAUGE_COUNT];
+static struct timespec start_time;
+
+static const char *counter_names[METRIC_COUNTER_COUNT] = {
+    "crawler_pages_fetched_total", "crawler_fetch_errors_total", "crawler_bytes_downloaded_total",
+    "crawler_links_extracted_total", "crawler_duplicate_pages_total", "crawler_fetch_retries_total",
+    "crawler_truncated_pages_total", "crawler_skipped_responses_total", "crawler_links_skipped_total",
+    "crawler_wire_bytes_total"};
+static const char *gauge_names[METRIC_GAUGE_COUNT] = {"crawler_queue_depth", "crawler_parse_queue_depth", "crawler_write_queue_depth"};
+static const char *histogram_names[METRIC_HISTOGRAM_COUNT] = {
+    "crawler_dns_seconds", "crawler_connect_seconds", "crawler_tls_seconds",
+    "crawler_ttfb_seconds", "crawler_fetch_seconds"};
+
+static const char *stage_names[STAGE_COUNT] = {"fetch", "store", "words", "dedup", "parse"};
+
+static int server_socket = -1;
+static atomic_int serving = 0;
+static pthread_t server_thread;
+
+/**
+ * Records the start time used for uptime and rates.
+ */
+void metrics_init(void) {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+}
+
+/**
+ * Returns the calling thread's shard, creating and registering it on first use.
+ */
+static MetricsShard *get_shard(void) {
+    if (thread_shard) {
+        return thread_shard;
+    }
+    MetricsShard *shard = calloc(1, sizeof(MetricsShard));
+    if (!shard) {
+        return NULL;
+    }
+    shard->next = atomic_load(&shards);
+    while (!atomic_compare_exchange_weak(&shards, &shard->next, shard)) {
+        // shard->next was refreshed with the current list head; retry
+    }
+    thread_shard = shard;
+    return shard;
+}
+
+static void local_add(_Atomic uint64_t *value, uint64_t amount) {
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+/**
+ * Maps a value to its log-linear bucket: values below METRICS_SUB_BUCKETS get their own
+ * bucket, larger ones keep their top METRICS_SUB_BUCKET_BITS + 1 significant bits.
+ */
+static int bucket_index(uint64_t value) {
+    if (value < METRICS_SUB_BUCKETS) {
+        return (int)value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - METRICS_SUB_BUCKET_BITS;
+    return (shift + 1) * METRICS_SUB_BUCKETS + (int)((value >> shift) & (METRICS_SUB_BUCKETS - 1));
+}
+
+/**
+ * Returns the largest value that falls into a bucket.
+ */
+static uint64_t bucket_upper_bound(int index) {
+    if (index < METRICS_SUB_BUCKETS) {
+        return (uint64_t)index;
+    }
+    int shift = index / METRICS_SUB_BUCKETS - 1;
+    uint64_t sub = (uint64_t)(index % METRICS_SUB_BUCKETS) + METRICS_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+/**
+ * Adds to one of the calling thread's counters.
+ */
+void metrics_add(MetricCounter counter, uint64_t amount) {
+    MetricsShard *shard = get_shard();
+    if (shard) {
+        local_add(&shard->counters[counter], amount);
+    }
+}
+
+/**
+ * Records one value (in microseconds) in one of the calling thread's histograms.
+ */
+void metrics_record(MetricHistogram histogram, uint64_t value) {
+    MetricsShard *shard = get_shard();
+    if (!shard) {
+        return;
+    }
+    local_add(&shard->histograms[histogram].count, 1);
+    local_add(&shard->histograms[histogram].sum, value);
+    local_add(&shard->histograms[histogram].buckets[bucket_index(value)], 1);
+    if (value > atomic_load_explicit(&shard->histograms[histogram].max, memory_order_relaxed)) {
+        atomic_store_explicit(&shard->histograms[histogram].max, value, memory_order_relaxed);
+    }
+}
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Starts timing a stage on the calling thread.
+ */
+void stage_timer_start(StageTimer *timer) {
+    timer->wall = clock_ns(CLOCK_MONOTONIC);
+    timer->cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+}
+
+/**
+ * Charges the elapsed and CPU time since the last start or lap to `stage`,
+ * and starts timing the next stage.
+ */
+void stage_timer_lap(StageTimer *timer, MetricStage stage) {
+    uint64_t wall = clock_ns(CLOCK_MONOTONIC);
+    uint64_t cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    MetricsShard *shard = get_shard();
+    if (shard) {
+        local_add(&shard->stage_wall_ns[stage], wall - timer->wall);
+        local_add(&shard->stage_cpu_ns[stage], cpu - timer->cpu);
+    }
+    timer->wall = wall;
+    timer->cpu = cpu;
+}
+
+const char *metrics_stage_name(MetricStage stage) {
+    return stage_names[stage];
+}
+
+/**
+ * Adjusts a process-wide gauge such as the queue depth.
+ */
+void metrics_gauge_add(MetricGauge gauge, int64_t amount) {
+    atomic_fetch_add_explicit(&gauges[gauge], amount, memory_order_relaxed);
+}
+
+/**
+ * Sums every thread's counters and histograms into `snapshot`.
+ */
+void metrics_snapshot(MetricsSnapshot *snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    snapshot->uptime = (double)(now.tv_sec - start_time.tv_sec) + (now.tv_nsec - start_time.tv_nsec) / 1e9;
+    for (int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        snapshot->gauges[i] = atomic_load_explicit(&gauges[i], memory_order_relaxed);
+    }
+    for (MetricsShard *shard = atomic_load(&shards); shard; shard = shard->next) {
+        for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+            snapshot->counters[i] += atomic_load_explicit(&shard->counters[i], memory_order_relaxed);
+        }
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            snapshot->stage_wall_ns[i] += atomic_load_explicit(&shard->stage_wall_ns[i], memory_order_relaxed);
+            snapshot->stage_cpu_ns[i] += atomic_load_explicit(&shard->stage_cpu_ns[i], memory_order_relaxed);
+        }
+        for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+            MetricsHistogram *total = &snapshot->histograms[h];
+            total->count += atomic_load_explicit(&shard->histograms[h].count, memory_order_relaxed);
+            total->sum += atomic_load_explicit(&shard->histograms[h].sum, memory_order_relaxed);
+            uint64_t max = atomic_load_explicit(&shard->histograms[h].max, memory_order_relaxed);
+            if (max > total->max) {
+                total->max = max;
+            }
+            for (int b = 0; b < METRICS_BUCKETS; b++) {
+                total->buckets[b] += atomic_load_explicit(&shard->histograms[h].buckets[b], memory_order_relaxed);
+            }
+        }
+    }
+}
+
+/**
+ * Returns the value at a percentile (0-100) of a histogram, as the upper bound of its
+ * bucket capped by the largest value seen. Returns 0 for an empty histogram.
+ */
+uint64_t metrics_percentile(const MetricsHistogram *histogram, double percentile) {
+    uint64_t total = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        total += histogram->buckets[b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        seen += histogram->buckets[b];
+        if (seen >= rank) {
+            uint64_t bound = bucket_upper_bound(b);
+            return bound < histogram->max ? bound : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+/**
+ * Writes a snapshot in the Prometheus text exposition format. Histograms are exported as
+ * summaries (quantiles computed here) since the log-linear buckets are too many to export.
+ * Returns the number of characters written, or -1 if `out` is too small.
+ */
+int metrics_format_prometheus(const MetricsSnapshot *snapshot, char *out, int capacity) {
+    static const double quantiles[] = {0.5, 0.9, 0.99};
+    int length = 0;
+    int n;
+#define EMIT(...)                                                      \
+    do {                                                               \
+        n = snprintf(out + length, (size_t)(capacity - length), __VA_ARGS__); \
+        if (n < 0 || n >= capacity - length) {                         \
+            return -1;                                                 \
+        }                                                              \
+        length += n;                                                   \
+    } while (0)
+
+    EMIT("# TYPE crawler_uptime_seconds gauge\ncrawler_uptime_seconds %.3f\n", snapshot->uptime);
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        EMIT("# TYPE %s counter\n%s %llu\n", counter_names[i], counter_names[i],
+             (unsigned long long)snapshot->counters[i]);
+    }
+    for (int i = 0; i < METRIC_GAUGE_COUNT; i++) {
+        EMIT("# TYPE %s gauge\n%s %lld\n", gauge_names[i], gauge_names[i], (long long)snapshot->gauges[i]);
+    }
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+        const MetricsHistogram *histogram = &snapshot->histograms[h];
+        EMIT("# TYPE %s summary\n", histogram_names[h]);
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+            EMIT("%s{quantile=\"%g\"} %.6f\n", histogram_names[h], quantiles[q],
+                 metrics_percentile(histogram, quantiles[q] * 100.0) / 1e6);
+        }
+        EMIT("%s_sum %.6f\n%s_count %llu\n", histogram_names[h], histogram->sum / 1e6,
+             histogram_names[h], (unsigned long long)histogram->count);
+    }
+    EMIT("# TYPE crawler_stage_seconds_total counter\n");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        EMIT("crawler_stage_seconds_total{stage=\"%s\"} %.6f\n", stage_names[i], snapshot->stage_wall_ns[i] / 1e9);
+    }
+    EMIT("# TYPE crawler_stage_cpu_seconds_total counter\n");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        EMIT("crawler_stage_cpu_seconds_total{stage=\"%s\"} %.6f\n", stage_names[i], snapshot->stage_cpu_ns[i] / 1e9);
+    }
+#undef EMIT
+    return length;
+}
+
+/**
+ * Answers one scrape: reads (and ignores) the request, then writes the current metrics.
+ */
+static void serve_client(int client, MetricsSnapshot *snapshot, char *body) {
+    char request[4096];
+    struct pollfd pfd = {client, POLLIN, 0};
+    if (poll(&pfd, 1, 1000) > 0) {
+        ssize_t ignored = read(client, request, sizeof(request));
+        (void)ignored;
+    }
+    metrics_snapshot(snapshot);
+    int length = metrics_format_prometheus(snapshot, body, METRICS_RESPONSE_MAX);
+    char header[128];
+    int header_length = snprintf(header, sizeof(header),
+                                 "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\n\r\n",
+                                 length < 0 ? "500 Internal Server Error" : "200 OK", length < 0 ? 0 : length);
+    if (write(client, header, (size_t)header_length) == header_length && length > 0) {
+        ssize_t written = 0;
+        while (written < length) {
+            ssize_t n = write(client, body + written, (size_t)(length - written));
+            if (n <= 0) {
+                break;
+            }
+            written += n;
+        }
+    }
+}
+
+static void *serve_metrics(void *arg) {
+    (void)arg;
+    MetricsSnapshot *snapshot = malloc(sizeof(MetricsSnapshot));
+    char *body = malloc(METRICS_RESPONSE_MAX);
+    while (snapshot && body && atomic_load(&serving)) {
+        struct pollfd pfd = {server_socket, POLLIN, 0};
+        if (poll(&pfd, 1, METRICS_POLL_MS) <= 0) {
+            continue;
+        }
+        int client = accept(server_socket, NULL, NULL);
+        if (client >= 0) {
+            serve_client(client, snapshot, body);
+            close(client);
+        }
+    }
+    free(snapshot);
+    free(body);
+    return NULL;
+}
+
+/**
+ * Starts serving the metrics in Prometheus text format on 127.0.0.1:port.
+ * Returns 0 on success, -1 on failure (errno is set).
+ */
+int metrics_serve_start(int port) {
+    server_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_socket < 0) {
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(server_socket, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(server_socket, 16) != 0) {
+        close(server_socket);
+        server_socket = -1;
+        return -1;
+    }
+    atomic_store(&serving, 1);
+    if (pthread_create(&server_thread, NULL, serve_metrics, NULL) != 0) {
+        atomic_store(&serving, 0);
+        close(server_socket);
+        server_socket = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Stops the metrics server, if it is running.
+ */
+void metrics_serve_stop(void) {
+    if (!atomic_load(&serving)) {
+        return;
+    }
+    atomic_store(&serving, 0);
+    pthread_join(server_thread, NULL);
+    close(server_socket);
+    server_socket = -1;
+}
+
+/**
+ * Frees every thread's shard. Must be called after all threads that record metrics have finished.
+ */
+void metrics_destroy(void) {
+    MetricsShard *shard = atomic_exchange(&shards, NULL);
+    while (shard) {
+        MetricsShard *next = shard->next;
+        free(shard);
+        shard = next;
+    }
+    thread_shard = NULL;
+}
@@ -0,0 +1,92 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+// Crawl metrics. Counters and latency histograms are kept per thread, written only by
+// their owner without locks, and summed when a snapshot is taken. Histograms are
+// log-linear (HDR-style): values are bucketed by power of two, and each power of two is
+// split into METRICS_SUB_BUCKETS linear sub-buckets, for about 6% relative error.
+#define METRICS_SUB_BUCKET_BITS 4
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_BUCKETS ((64 - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS)
+
+typedef enum {
+    METRIC_PAGES_FETCHED = 0,
+    METRIC_FETCH_ERRORS,
+    METRIC_BYTES_DOWNLOADED,
+    METRIC_LINKS_EXTRACTED,
+    METRIC_DUPLICATE_PAGES,
+    METRIC_FETCH_RETRIES,
+    METRIC_TRUNCATED_PAGES,
+    METRIC_SKIPPED_RESPONSES,
+    METRIC_LINKS_SKIPPED,
+    METRIC_WIRE_BYTES,
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+// Latencies in microseconds, taken from curl's timing info
+typedef enum {
+    METRIC_DNS_TIME = 0,
+    METRIC_CONNECT_TIME,
+    METRIC_TLS_TIME,
+    METRIC_TTFB_TIME,
+    METRIC_TOTAL_TIME,
+    METRIC_HISTOGRAM_COUNT
+} MetricHistogram;
+
+// Stages of processing one page, timed per thread
+typedef enum {
+    STAGE_FETCH = 0, // Network transfer (includes fingerprinting the body as it arrives)
+    STAGE_STORE,     // Writing the body, page record and urls.txt line
+    STAGE_WORDS,     // Word counting and SimHash
+    STAGE_DEDUP,     // Exact and near-duplicate lookup
+    STAGE_PARSE,     // Link extraction, visited check and enqueueing
+    STAGE_COUNT
+} MetricStage;
+
+// Start of the stage currently being timed on one thread
+typedef struct {
+    uint64_t wall;
+    uint64_t cpu;
+} StageTimer;
+
+typedef enum {
+    METRIC_QUEUE_DEPTH = 0,    // URLs waiting to be fetched
+    METRIC_PARSE_QUEUE_DEPTH, // Fetched pages waiting for a parse thread
+    METRIC_WRITE_QUEUE_DEPTH, // Parsed pages waiting for a write thread
+    METRIC_GAUGE_COUNT
+} MetricGauge;
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[METRICS_BUCKETS];
+} MetricsHistogram;
+
+// Totals over all threads at one point in time
+typedef struct {
+    double uptime;                 // Seconds since metrics_init
+    uint64_t counters[METRIC_COUNTER_COUNT];
+    int64_t gauges[METRIC_GAUGE_COUNT];
+    MetricsHistogram histograms[METRIC_HISTOGRAM_COUNT];
+    uint64_t stage_wall_ns[STAGE_COUNT]; // Elapsed time spent in each stage
+    uint64_t stage_cpu_ns[STAGE_COUNT];  // CPU time of the timed threads spent in each stage
+} MetricsSnapshot;
+
+void metrics_init(void);
+void metrics_add(MetricCounter counter, uint64_t amount);
+void metrics_record(MetricHistogram histogram, uint64_t value);
+void stage_timer_start(StageTimer *timer);
+void stage_timer_lap(StageTimer *timer, MetricStage stage);
+const char *metrics_stage_name(MetricStage stage);
+void metrics_gauge_add(MetricGauge gauge, int64_t amount);
+void metrics_snapshot(MetricsSnapshot *snapshot);
+uint64_t metrics_percentile(const MetricsHistogram *histogram, double percentile);
+int metrics_format_prometheus(const MetricsSnapshot *snapshot, char *out, int capacity);
+int metrics_serve_start(int port);
+void metrics_serve_stop(void);
+void metrics_destroy(void);
+
+#endif
@@ -0,0 +1,179 @@
+// Tell compiler to use POSIX.1-2008 and later, plus syscall() for the futex on Linux
+#ifdef __linux__
+#define _DEFAULT_SOURCE
+#endif
+#define _POSIX_C_SOURCE 200809L
+#include "mpmc_queue.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Returns the sequence number of the cell at `position`.
+ */
+static _Atomic size_t *cell_sequence(MpmcQueue *queue, size_t position) {
+    return (_Atomic size_t *)(queue->cells + (position & queue->mask) * queue->cell_size);
+}
+
+static unsigned char *cell_item(MpmcQueue *queue, size_t position) {
+    return queue->cells + (position & queue->mask) * queue->cell_size + _Alignof(max_align_t);
+}
+
+/**
+ * Allocates a queue of `capacity` items (rounded up to a power of two) of `item_size`
+ * bytes each. Returns 0 on success, -1 on failure.
+ */
+int mpmc_queue_init(MpmcQueue *queue, size_t capacity, size_t item_size) {
+    size_t cells = 2;
+    while (cells < capacity) {
+        cells *= 2;
+    }
+    // The item starts after the sequence number, at max_align_t alignment
+    size_t align = _Alignof(max_align_t);
+    queue->cell_size = (align + item_size + align - 1) / align * align;
+    queue->cells = aligned_alloc(align, cells * queue->cell_size);
+    if (!queue->cells) {
+        return -1;
+    }
+    queue->mask = cells - 1;
+    queue->item_size = item_size;
+    for (size_t i = 0; i < cells; i++) {
+        atomic_init(cell_sequence(queue, i), i); // Cell i is free for the producer of position i
+    }
+    atomic_init(&queue->enqueue_pos, 0);
+    atomic_init(&queue->dequeue_pos, 0);
+    return 0;
+}
+
+/**
+ * Copies an item into the queue. Returns 0 on success, -1 if the queue is full.
+ */
+int mpmc_queue_push(MpmcQueue *queue, const void *item) {
+    size_t position = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    while (1) {
+        size_t sequence = atomic_load_explicit(cell_sequence(queue, position), memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)position;
+        if (diff == 0) {
+            // Cell is free: claim the position (on failure `position` is reloaded)
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return -1; // Cell still holds the item from one lap ago
+        } else {
+            position = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    memcpy(cell_item(queue, position), item, queue->item_size);
+    atomic_store_explicit(cell_sequence(queue, position), position + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Copies the oldest item out of the queue. Returns 0 on success, -1 if the queue is empty.
+ */
+int mpmc_queue_pop(MpmcQueue *queue, void *item) {
+    size_t position = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    while (1) {
+        size_t sequence = atomic_load_explicit(cell_sequence(queue, position), memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(position + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return -1; // Cell not filled yet
+        } else {
+            position = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    memcpy(item, cell_item(queue, position), queue->item_size);
+    // Free the cell for the producer one lap ahead
+    atomic_store_explicit(cell_sequence(queue, position), position + queue->mask + 1, memory_order_release);
+    return 0;
+}
+
+void mpmc_queue_destroy(MpmcQueue *queue) {
+    free(queue->cells);
+    queue->cells = NULL;
+}
+
+void parker_init(Parker *parker) {
+    atomic_init(&parker->epoch, 0);
+    atomic_init(&parker->waiters, 0);
+#ifndef __linux__
+    pthread_mutex_init(&parker->lock, NULL);
+    pthread_cond_init(&parker->cond, NULL);
+#endif
+}
+
+/**
+ * Announces that the calling thread is about to wait. Returns the epoch to pass to
+ * parker_wait; any wake after this call makes that wait return immediately.
+ */
+uint32_t parker_prepare(Parker *parker) {
+    atomic_fetch_add(&parker->waiters, 1);
+    return atomic_load(&parker->epoch);
+}
+
+/**
+ * Withdraws a parker_prepare when the condition turned out to be met.
+ */
+void parker_cancel(Parker *parker) {
+    atomic_fetch_sub(&parker->waiters, 1);
+}
+
+/**
+ * Sleeps until parker_wake is called, unless it was already called since parker_prepare
+ * returned `epoch`. May return spuriously, so callers check their condition again.
+ */
+void parker_wait(Parker *parker, uint32_t epoch) {
+#ifdef __linux__
+    syscall(SYS_futex, &parker->epoch, FUTEX_WAIT_PRIVATE, epoch, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&parker->lock);
+    while (atomic_load(&parker->epoch) == epoch) {
+        pthread_cond_wait(&parker->cond, &parker->lock);
+    }
+    pthread_mutex_unlock(&parker->lock);
+#endif
+    atomic_fetch_sub(&parker->waiters, 1);
+}
+
+/**
+ * Wakes up to `count` parked threads (PARKER_WAKE_ALL for all of them) with one system call.
+ * Call it after making the condition the waiters check true.
+ */
+void parker_wake(Parker *parker, int count) {
+    atomic_fetch_add(&parker->epoch, 1);
+    if (atomic_load(&parker->waiters) == 0) {
+        return;
+    }
+#ifdef __linux__
+    syscall(SYS_futex, &parker->epoch, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&parker->lock);
+    if (count > 1) {
+        pthread_cond_broadcast(&parker->cond);
+    } else {
+        pthread_cond_signal(&parker->cond);
+    }
+    pthread_mutex_unlock(&parker->lock);
+#endif
+}
+
+void parker_destroy(Parker *parker) {
+#ifndef __linux__
+    pthread_mutex_destroy(&parker->lock);
+    pthread_cond_destroy(&parker->cond);
+#else
+    (void)parker;
+#endif
+}
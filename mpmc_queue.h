@@ -0,0 +1,49 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+
+// Lock-free bounded multi-producer multi-consumer FIFO of fixed-size items (Dmitry Vyukov's
+// design). Every cell carries a sequence number telling whether it is free for the producer
+// of a given position or filled for its consumer, so a push or pop is one CAS on the shared
+// position plus a copy of the item, and producers and consumers never take a lock.
+typedef struct {
+    _Alignas(64) _Atomic size_t enqueue_pos; // Next position to fill
+    _Alignas(64) _Atomic size_t dequeue_pos; // Next position to take
+    _Alignas(64) unsigned char *cells;       // Sequence number followed by the item, per cell
+    size_t mask;                             // Capacity - 1 (capacity is a power of two)
+    size_t item_size;
+    size_t cell_size;
+} MpmcQueue;
+
+// Parking spot for threads waiting on a lock-free structure (an event count).
+// A waiter calls parker_prepare, checks its condition once more, and then either calls
+// parker_cancel or parker_wait; a waker changes the condition and calls parker_wake, which
+// costs only two atomic operations when nobody is parked. Waiters sleep on a futex on
+// Linux and on a condition variable elsewhere.
+#define PARKER_WAKE_ALL INT_MAX
+typedef struct {
+    _Atomic uint32_t epoch; // Bumped by every wake
+    _Atomic int waiters;
+#ifndef __linux__
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+} Parker;
+
+int mpmc_queue_init(MpmcQueue *queue, size_t capacity, size_t item_size);
+int mpmc_queue_push(MpmcQueue *queue, const void *item);
+int mpmc_queue_pop(MpmcQueue *queue, void *item);
+void mpmc_queue_destroy(MpmcQueue *queue);
+
+void parker_init(Parker *parker);
+uint32_t parker_prepare(Parker *parker);
+void parker_cancel(Parker *parker);
+void parker_wait(Parker *parker, uint32_t epoch);
+void parker_wake(Parker *parker, int count);
+void parker_destroy(Parker *parker);
+
+#endif
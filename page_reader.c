@@ -0,0 +1,170 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like mmap
+#define _POSIX_C_SOURCE 200809L
+#include "page_reader.h"
+#include "url_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define READER_PATH_LENGTH 512
+
+/**
+ * Maps a whole file read-only. Empty files are represented by a NULL map of length 0.
+ */
+static int map_file(const char *path, MappedFile *file) {
+    file->map = NULL;
+    file->length = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        file->map = map;
+        file->length = (size_t)st.st_size;
+    }
+    close(fd);
+    return 0;
+}
+
+static void unmap_file(MappedFile *file) {
+    if (file->map) {
+        munmap(file->map, file->length);
+    }
+    file->map = NULL;
+    file->length = 0;
+}
+
+/**
+ * Maps pages.idx, bodies.idx and every segment of the store in `dir` and checks that
+ * the index sizes are consistent. Returns 0 on success, -1 on failure.
+ */
+int page_store_open(const char *dir, PageStore *store) {
+    char path[READER_PATH_LENGTH + 32];
+    memset(store, 0, sizeof(*store));
+
+    snprintf(path, sizeof(path), "%s/%s", dir, STORE_PAGE_INDEX_FILE);
+    if (map_file(path, &store->page_index) != 0 || store->page_index.length < sizeof(StorePageIndexHeader)) {
+        page_store_close(store);
+        return -1;
+    }
+    const StorePageIndexHeader *header = store->page_index.map;
+    size_t expected = sizeof(*header) + header->page_count * sizeof(StorePageRecord) +
+                      header->slot_count * sizeof(uint32_t) + header->url_bytes;
+    if (memcmp(header->magic, STORE_PAGE_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+        expected != store->page_index.length || header->slot_count == 0) {
+        page_store_close(store);
+        return -1;
+    }
+    store->header = header;
+    store->records = (const StorePageRecord *)(header + 1);
+    store->url_slots = (const uint32_t *)(store->records + header->page_count);
+    store->url_area = (const char *)(store->url_slots + header->slot_count);
+
+    snprintf(path, sizeof(path), "%s/%s", dir, STORE_BODIES_FILE);
+    if (map_file(path, &store->bodies) != 0 || store->bodies.length % sizeof(StoreBodyRecord) != 0) {
+        page_store_close(store);
+        return -1;
+    }
+    store->body_records = store->bodies.map;
+    store->body_count = store->bodies.length / sizeof(StoreBodyRecord);
+
+    // Segments are numbered consecutively; bodies may be recorded out of write order,
+    // so the highest segment number of any body tells how many there are
+    store->segment_count = 0;
+    for (uint64_t i = 0; i < store->body_count; i++) {
+        if (store->body_records[i].segment + 1 > store->segment_count) {
+            store->segment_count = store->body_records[i].segment + 1;
+        }
+    }
+    if (store->segment_count > 0) {
+        store->segments = calloc(store->segment_count, sizeof(MappedFile));
+        if (!store->segments) {
+            page_store_close(store);
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < store->segment_count; i++) {
+        snprintf(path, sizeof(path), "%s/segment_%u.dat", dir, i);
+        if (map_file(path, &store->segments[i]) != 0) {
+            page_store_close(store);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Looks up a page by page number. Returns 0 and fills *page if found, -1 otherwise.
+ */
+int page_store_get(const PageStore *store, uint32_t page_id, StoredPage *page) {
+    if (page_id >= store->header->page_count) {
+        return -1;
+    }
+    const StorePageRecord *record = &store->records[page_id];
+    if (record->body_id == STORE_NO_BODY || record->body_id >= store->body_count) {
+        return -1;
+    }
+    const StoreBodyRecord *body = &store->body_records[record->body_id];
+    const MappedFile *segment = &store->segments[body->segment];
+    if (body->offset + body->length > segment->length) {
+        return -1; // Truncated segment
+    }
+    page->page_id = page_id;
+    page->body_id = record->body_id;
+    page->url = store->url_area + record->url_offset;
+    page->body = (const char *)segment->map + body->offset;
+    page->length = body->length;
+    page->fingerprint.hi = body->fp_hi;
+    page->fingerprint.lo = body->fp_lo;
+    return 0;
+}
+
+/**
+ * Looks up a page by URL through the hash table in pages.idx.
+ * Returns 0 and fills *page if found, -1 otherwise.
+ */
+int page_store_find(const PageStore *store, const char *url, StoredPage *page) {
+    uint64_t hash = url_hash(url);
+    uint64_t mask = store->header->slot_count - 1;
+    for (uint64_t slot = hash & mask; store->url_slots[slot] != STORE_NO_PAGE; slot = (slot + 1) & mask) {
+        const StorePageRecord *record = &store->records[store->url_slots[slot]];
+        if (record->url_hash == hash && strcmp(store->url_area + record->url_offset, url) == 0) {
+            return page_store_get(store, store->url_slots[slot], page);
+        }
+    }
+    return -1;
+}
+
+/**
+ * Returns one past the highest page number in the store.
+ */
+uint64_t page_store_page_limit(const PageStore *store) {
+    return store->header->page_count;
+}
+
+/**
+ * Unmaps every file of the store.
+ */
+void page_store_close(PageStore *store) {
+    unmap_file(&store->page_index);
+    unmap_file(&store->bodies);
+    for (uint32_t i = 0; store->segments && i < store->segment_count; i++) {
+        unmap_file(&store->segments[i]);
+    }
+    free(store->segments);
+    memset(store, 0, sizeof(*store));
+}
@@ -0,0 +1,46 @@
+#ifndef PAGE_READER_H
+#define PAGE_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "content_store.h"
+
+// Read-only, zero-copy access to a finished page store. The page index, the body index
+// and every segment are memory-mapped when the store is opened; lookups by page number
+// or URL return pointers straight into the mapped segments.
+
+typedef struct {
+    void *map;
+    size_t length;
+} MappedFile;
+
+typedef struct {
+    MappedFile page_index;
+    MappedFile bodies;
+    MappedFile *segments;
+    uint32_t segment_count;
+    const StorePageIndexHeader *header;
+    const StorePageRecord *records;
+    const uint32_t *url_slots;
+    const char *url_area;
+    const StoreBodyRecord *body_records;
+    uint64_t body_count;
+} PageStore;
+
+// One page as returned by a lookup; pointers stay valid until page_store_close
+typedef struct {
+    uint32_t page_id;
+    uint64_t body_id;
+    const char *url;
+    const char *body;      // Not NUL-terminated
+    size_t length;
+    Fingerprint fingerprint;
+} StoredPage;
+
+int page_store_open(const char *dir, PageStore *store);
+int page_store_get(const PageStore *store, uint32_t page_id, StoredPage *page);
+int page_store_find(const PageStore *store, const char *url, StoredPage *page);
+uint64_t page_store_page_limit(const PageStore *store);
+void page_store_close(PageStore *store);
+
+#endif
@@ -0,0 +1,267 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like pthread barriers
+#define _POSIX_C_SOURCE 200809L
+#include "pagerank.h"
+#include "link_graph.h"
+#include "lock_profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#define PAGERANK_MAX_THREADS 256
+
+// State shared by all PageRank workers
+typedef struct {
+    uint64_t n;
+    const uint64_t *in_offsets;   // Transposed graph: in-links of v are in_sources[in_offsets[v] .. in_offsets[v+1])
+    const uint32_t *in_sources;
+    const uint32_t *out_degree;
+    double *rank;
+    double *next;
+    double *contrib;              // rank[u] / out_degree[u] for the current iteration
+    double dangling[PAGERANK_MAX_THREADS]; // Per-thread rank mass of pages without out-links
+    double delta[PAGERANK_MAX_THREADS];    // Per-thread L1 change
+    uint64_t bounds[PAGERANK_MAX_THREADS + 1]; // Row range of each thread
+    int threads;
+    int iterations;
+    pthread_barrier_t barrier;
+    // Workers wait here until it is known how many of them started and their rows are set
+    pthread_mutex_t start_lock;
+    pthread_cond_t start_cond;
+    int started;
+} PageRankShared;
+
+typedef struct {
+    PageRankShared *shared;
+    int id;
+} PageRankWorker;
+
+/**
+ * Worker loop. Each iteration has two phases separated by barriers:
+ * first every thread computes the outgoing contribution of its rows, then every thread
+ * pulls the contributions along the in-links of its rows into the next rank vector.
+ */
+static void *pagerank_worker(void *arg) {
+    PageRankWorker *worker = arg;
+    PageRankShared *s = worker->shared;
+    MUTEX_LOCK_NAMED(&s->start_lock, "pagerank start");
+    while (!s->started) {
+        COND_WAIT(&s->start_cond, &s->start_lock);
+    }
+    MUTEX_UNLOCK(&s->start_lock);
+    uint64_t lo = s->bounds[worker->id], hi = s->bounds[worker->id + 1];
+    double *rank = s->rank, *next = s->next;
+    double teleport = (1.0 - PAGERANK_DAMPING) / (double)s->n;
+
+    for (int iteration = 1; iteration <= PAGERANK_MAX_ITERATIONS; iteration++) {
+        double dangling = 0.0;
+        for (uint64_t v = lo; v < hi; v++) {
+            if (s->out_degree[v]) {
+                s->contrib[v] = rank[v] / s->out_degree[v];
+            } else {
+                s->contrib[v] = 0.0;
+                dangling += rank[v];
+            }
+        }
+        s->dangling[worker->id] = dangling;
+        pthread_barrier_wait(&s->barrier);
+
+        // Rank of dangling pages is spread evenly over all pages
+        double dangling_total = 0.0;
+        for (int t = 0; t < s->threads; t++) {
+            dangling_total += s->dangling[t];
+        }
+        double base = teleport + PAGERANK_DAMPING * dangling_total / (double)s->n;
+        double delta = 0.0;
+        for (uint64_t v = lo; v < hi; v++) {
+            double sum = 0.0;
+            for (uint64_t e = s->in_offsets[v]; e < s->in_offsets[v + 1]; e++) {
+                sum += s->contrib[s->in_sources[e]];
+            }
+            next[v] = base + PAGERANK_DAMPING * sum;
+            delta += fabs(next[v] - rank[v]);
+        }
+        s->delta[worker->id] = delta;
+        pthread_barrier_wait(&s->barrier);
+
+        // Every thread reaches the same convergence decision from the same partial sums
+        double delta_total = 0.0;
+        for (int t = 0; t < s->threads; t++) {
+            delta_total += s->delta[t];
+        }
+        double *swap = rank;
+        rank = next;
+        next = swap;
+        if (delta_total < PAGERANK_TOLERANCE || iteration == PAGERANK_MAX_ITERATIONS) {
+            if (worker->id == 0) {
+                s->iterations = iteration;
+                s->rank = rank; // Final scores live in whichever buffer was written last
+                s->next = next;
+            }
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Computes PageRank for every node of the graph file using up to `threads` workers (fewer if
+ * some fail to start).
+ * Rows are split so that every thread gets about the same number of in-links.
+ * Returns 0 on success, -1 if the graph cannot be read or memory runs out.
+ */
+int pagerank_compute(const char *graph_path, int threads, PageRankResult *result) {
+    LinkGraph graph;
+    memset(result, 0, sizeof(*result));
+    if (graph_map(graph_path, &graph) != 0) {
+        return -1;
+    }
+    uint64_t n = graph.node_count;
+    if (n == 0) {
+        graph_unmap(&graph);
+        return 0;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > PAGERANK_MAX_THREADS) {
+        threads = PAGERANK_MAX_THREADS;
+    }
+    if ((uint64_t)threads > n) {
+        threads = (int)n;
+    }
+
+    PageRankShared *s = calloc(1, sizeof(PageRankShared));
+    uint64_t *in_offsets = calloc(n + 1, sizeof(uint64_t));
+    uint32_t *in_sources = malloc((graph.edge_count ? graph.edge_count : 1) * sizeof(uint32_t));
+    uint32_t *out_degree = malloc(n * sizeof(uint32_t));
+    double *rank = malloc(n * sizeof(double));
+    double *next = malloc(n * sizeof(double));
+    double *contrib = malloc(n * sizeof(double));
+    int status = -1;
+    if (!s || !in_offsets || !in_sources || !out_degree || !rank || !next || !contrib) {
+        goto done;
+    }
+
+    // Transpose the graph: count in-links, prefix-sum, then fill
+    GraphRowIterator it;
+    uint32_t target;
+    for (uint64_t u = 0; u < n; u++) {
+        out_degree[u] = graph_row_begin(&graph, (uint32_t)u, &it);
+        while (graph_row_next(&it, &target)) {
+            in_offsets[target + 1]++;
+        }
+    }
+    for (uint64_t v = 0; v < n; v++) {
+        in_offsets[v + 1] += in_offsets[v];
+    }
+    uint64_t *fill = malloc(n * sizeof(uint64_t));
+    if (!fill) {
+        goto done;
+    }
+    memcpy(fill, in_offsets, n * sizeof(uint64_t));
+    for (uint64_t u = 0; u < n; u++) {
+        graph_row_begin(&graph, (uint32_t)u, &it);
+        while (graph_row_next(&it, &target)) {
+            in_sources[fill[target]++] = (uint32_t)u;
+        }
+    }
+    free(fill);
+
+    for (uint64_t i = 0; i < n; i++) {
+        rank[i] = 1.0 / (double)n;
+    }
+    s->n = n;
+    s->in_offsets = in_offsets;
+    s->in_sources = in_sources;
+    s->out_degree = out_degree;
+    s->rank = rank;
+    s->next = next;
+    s->contrib = contrib;
+
+    pthread_t workers[PAGERANK_MAX_THREADS];
+    PageRankWorker args[PAGERANK_MAX_THREADS];
+    pthread_mutex_init(&s->start_lock, NULL);
+    pthread_cond_init(&s->start_cond, NULL);
+    int started = 1; // The calling thread works as worker 0
+    while (started < threads) {
+        args[started].shared = s;
+        args[started].id = started;
+        if (pthread_create(&workers[started], NULL, pagerank_worker, &args[started]) != 0) {
+            break; // Carry on with the workers that did start
+        }
+        started++;
+    }
+
+    // Balance the workers by in-link count (plus one per row for the per-row work)
+    s->threads = started;
+    uint64_t total_work = in_offsets[n] + n;
+    uint64_t v = 0;
+    s->bounds[0] = 0;
+    for (int t = 1; t < started; t++) {
+        uint64_t goal = total_work * (uint64_t)t / (uint64_t)started;
+        while (v < n && in_offsets[v] + v < goal) {
+            v++;
+        }
+        s->bounds[t] = v;
+    }
+    s->bounds[started] = n;
+    pthread_barrier_init(&s->barrier, NULL, (unsigned)started);
+
+    MUTEX_LOCK_NAMED(&s->start_lock, "pagerank start");
+    s->started = 1;
+    pthread_cond_broadcast(&s->start_cond);
+    MUTEX_UNLOCK(&s->start_lock);
+    args[0].shared = s;
+    args[0].id = 0;
+    pagerank_worker(&args[0]);
+    for (int t = 1; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    pthread_barrier_destroy(&s->barrier);
+    pthread_mutex_destroy(&s->start_lock);
+    pthread_cond_destroy(&s->start_cond);
+
+    result->scores = s->rank;
+    result->node_count = n;
+    result->iterations = s->iterations;
+    // Hand the final buffer to the caller and free the other one
+    if (s->rank == rank) {
+        rank = NULL;
+    } else {
+        next = NULL;
+    }
+    status = 0;
+
+done:
+    graph_unmap(&graph);
+    free(s);
+    free(in_offsets);
+    free(in_sources);
+    free(out_degree);
+    free(rank);
+    free(next);
+    free(contrib);
+    return status;
+}
+
+/**
+ * Writes one line per URL id: id, score and URL.
+ */
+int pagerank_write(const char *path, const PageRankResult *result, UrlTable *urls) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return -1;
+    }
+    for (uint64_t i = 0; i < result->node_count; i++) {
+        const char *url = url_table_get(urls, (uint32_t)i);
+        fprintf(file, "%llu\t%.10e\t%s\n", (unsigned long long)i, result->scores[i], url ? url : "");
+    }
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+void pagerank_free(PageRankResult *result) {
+    free(result->scores);
+    result->scores = NULL;
+}
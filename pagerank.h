@@ -0,0 +1,24 @@
+#ifndef PAGERANK_H
+#define PAGERANK_H
+
+#include <stdint.h>
+#include "url_table.h"
+
+// PageRank over the stored link graph (store/graph.csr), computed by power iteration
+// with the rows of the transposed graph split across worker threads.
+#define PAGERANK_FILE "pagerank.tsv"
+#define PAGERANK_DAMPING 0.85
+#define PAGERANK_MAX_ITERATIONS 100
+#define PAGERANK_TOLERANCE 1e-9 // Stop once the L1 change of an iteration drops below this
+
+typedef struct {
+    double *scores;      // Score of each URL id; scores sum to 1
+    uint64_t node_count;
+    int iterations;      // Iterations run before convergence (or the cap)
+} PageRankResult;
+
+int pagerank_compute(const char *graph_path, int threads, PageRankResult *result);
+int pagerank_write(const char *path, const PageRankResult *result, UrlTable *urls);
+void pagerank_free(PageRankResult *result);
+
+#endif
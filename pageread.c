@@ -0,0 +1,87 @@
+// Command-line reader for the crawler's page store.
+// Prints a stored page by URL or page number without copying it out of the memory map.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "page_reader.h"
+
+/**
+ * Prints usage information.
+ */
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-s store_dir] [-m] URL\n", program);
+    fprintf(stderr, "       %s [-s store_dir] [-m] -i PAGE_NUMBER\n", program);
+    fprintf(stderr, "       %s [-s store_dir] -l\n", program);
+    fprintf(stderr, "  -s  store directory (default: %s)\n", STORE_DIR);
+    fprintf(stderr, "  -m  print page metadata instead of the HTML body\n");
+    fprintf(stderr, "  -i  look the page up by page number instead of URL\n");
+    fprintf(stderr, "  -l  list every stored page\n");
+}
+
+/**
+ * Prints one line of metadata: page number, body id, length, fingerprint, URL.
+ */
+static void print_metadata(const StoredPage *page) {
+    char hex[FINGERPRINT_HEX_LENGTH];
+    fingerprint_to_hex(&page->fingerprint, hex);
+    printf("%u\t%llu\t%zu\t%s\t%s\n", page->page_id, (unsigned long long)page->body_id,
+           page->length, hex, page->url);
+}
+
+int main(int argc, char *argv[]) {
+    const char *dir = STORE_DIR;
+    const char *key = NULL;
+    int by_id = 0, metadata = 0, list = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            metadata = 1;
+        } else if (strcmp(argv[i], "-l") == 0) {
+            list = 1;
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            by_id = 1;
+            key = argv[++i];
+        } else if (argv[i][0] != '-' && !key) {
+            key = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!list && !key) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    PageStore store;
+    if (page_store_open(dir, &store) != 0) {
+        fprintf(stderr, "Error: cannot open page store in %s\n", dir);
+        return 1;
+    }
+
+    int status = 0;
+    StoredPage page;
+    if (list) {
+        for (uint64_t id = 0; id < page_store_page_limit(&store); id++) {
+            if (page_store_get(&store, (uint32_t)id, &page) == 0) {
+                print_metadata(&page);
+            }
+        }
+    } else {
+        int found = by_id ? page_store_get(&store, (uint32_t)strtoul(key, NULL, 10), &page)
+                          : page_store_find(&store, key, &page);
+        if (found != 0) {
+            fprintf(stderr, "Page not found: %s\n", key);
+            status = 1;
+        } else if (metadata) {
+            print_metadata(&page);
+        } else if (fwrite(page.body, 1, page.length, stdout) != page.length) {
+            perror("Error writing page");
+            status = 1;
+        }
+    }
+    page_store_close(&store);
+    return status;
+}
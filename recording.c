@@ -0,0 +1,228 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like mmap
+#define _POSIX_C_SOURCE 200809L
+#include "recording.h"
+#include "lock_profile.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define REPLAY_NO_ENTRY UINT32_MAX // Empty slot in the replay hash table
+
+static FILE *record_file = NULL;
+static pthread_mutex_t record_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *replay_map = NULL;
+static size_t replay_length = 0;
+static RecordedResponse *replay_entries = NULL;
+static size_t replay_entry_count = 0;
+static uint32_t *replay_slots = NULL; // Open-addressing table of entry numbers keyed by URL hash
+static size_t replay_slot_count = 0;  // Power of two
+
+/**
+ * 64-bit FNV-1a hash of a URL of known length (the same hash as url_hash).
+ */
+static uint64_t hash_bytes(const char *url, size_t length) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (unsigned char)url[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/**
+ * Creates (or truncates) the recording file. Returns 0 on success, -1 on failure.
+ */
+int recording_open(const char *path) {
+    record_file = fopen(path, "wb");
+    if (!record_file) {
+        return -1;
+    }
+    if (fwrite(RECORDING_MAGIC, 1, 8, record_file) != 8) {
+        fclose(record_file);
+        record_file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Appends one response to the recording. Safe to call from several threads.
+ * Returns 0 on success, -1 on write failure.
+ */
+int recording_add(const RecordedResponse *response) {
+    RecordingEntryHeader header;
+    memset(&header, 0, sizeof(header));
+    header.url_length = (uint32_t)response->url_length;
+    header.header_length = (uint32_t)response->header_length;
+    header.body_length = response->body_length;
+    header.status = response->status;
+    header.result = response->result;
+    header.timings = response->timings;
+
+    MUTEX_LOCK(&record_lock);
+    int ok = fwrite(&header, sizeof(header), 1, record_file) == 1 &&
+             fwrite(response->url, 1, response->url_length, record_file) == response->url_length &&
+             fwrite(response->headers, 1, response->header_length, record_file) == response->header_length &&
+             fwrite(response->body, 1, response->body_length, record_file) == response->body_length;
+    MUTEX_UNLOCK(&record_lock);
+    return ok ? 0 : -1;
+}
+
+/**
+ * Flushes and closes the recording. Returns 0 on success, -1 if any write failed.
+ */
+int recording_close(void) {
+    if (!record_file) {
+        return 0;
+    }
+    int failed = ferror(record_file);
+    failed |= fclose(record_file) != 0;
+    record_file = NULL;
+    return failed ? -1 : 0;
+}
+
+/**
+ * Returns the slot holding the entry for `url`, or the empty slot where it would go.
+ */
+static size_t find_slot(const char *url, size_t length, uint64_t hash) {
+    size_t i = (size_t)hash & (replay_slot_count - 1);
+    while (replay_slots[i] != REPLAY_NO_ENTRY) {
+        const RecordedResponse *entry = &replay_entries[replay_slots[i]];
+        if (entry->url_length == length && memcmp(entry->url, url, length) == 0) {
+            break;
+        }
+        i = (i + 1) & (replay_slot_count - 1); // Linear probing
+    }
+    return i;
+}
+
+/**
+ * Maps a recording and indexes its responses by URL. When a URL was recorded more than
+ * once, the first response is replayed. Returns 0 on success, -1 on failure (errno is set
+ * to EINVAL for a file that is not a valid recording).
+ */
+int replay_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size < 8) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    replay_map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (replay_map == MAP_FAILED) {
+        replay_map = NULL;
+        return -1;
+    }
+    replay_length = (size_t)st.st_size;
+    const char *data = replay_map;
+    if (memcmp(data, RECORDING_MAGIC, 8) != 0) {
+        replay_close();
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Walk the entries; the headers are unaligned inside the file, so they are copied out
+    size_t capacity = 0;
+    size_t offset = 8;
+    while (offset < replay_length) {
+        RecordingEntryHeader header;
+        if (replay_length - offset < sizeof(header)) {
+            break; // Truncated entry (the recording crawl was interrupted)
+        }
+        memcpy(&header, data + offset, sizeof(header));
+        offset += sizeof(header);
+        uint64_t payload = (uint64_t)header.url_length + header.header_length + header.body_length;
+        if (payload > replay_length - offset) {
+            break;
+        }
+        if (replay_entry_count == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 1024;
+            RecordedResponse *entries = realloc(replay_entries, new_capacity * sizeof(RecordedResponse));
+            if (!entries) {
+                replay_close();
+                return -1;
+            }
+            replay_entries = entries;
+            capacity = new_capacity;
+        }
+        RecordedResponse *entry = &replay_entries[replay_entry_count++];
+        entry->url = data + offset;
+        entry->url_length = header.url_length;
+        entry->headers = entry->url + header.url_length;
+        entry->header_length = header.header_length;
+        entry->body = entry->headers + header.header_length;
+        entry->body_length = header.body_length;
+        entry->status = header.status;
+        entry->result = header.result;
+        entry->timings = header.timings;
+        offset += payload;
+    }
+
+    replay_slot_count = 1024;
+    while (replay_slot_count < replay_entry_count * 2) {
+        replay_slot_count *= 2;
+    }
+    replay_slots = malloc(replay_slot_count * sizeof(uint32_t));
+    if (!replay_slots) {
+        replay_close();
+        return -1;
+    }
+    memset(replay_slots, 0xff, replay_slot_count * sizeof(uint32_t)); // All REPLAY_NO_ENTRY
+    for (size_t i = 0; i < replay_entry_count; i++) {
+        const RecordedResponse *entry = &replay_entries[i];
+        size_t slot = find_slot(entry->url, entry->url_length, hash_bytes(entry->url, entry->url_length));
+        if (replay_slots[slot] == REPLAY_NO_ENTRY) {
+            replay_slots[slot] = (uint32_t)i;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Returns the recorded response for a URL, or NULL if the URL was not recorded.
+ * The table is read-only once open, so lookups need no locking.
+ */
+const RecordedResponse *replay_find(const char *url) {
+    if (!replay_slots) {
+        return NULL;
+    }
+    size_t length = strlen(url);
+    size_t slot = find_slot(url, length, hash_bytes(url, length));
+    return replay_slots[slot] == REPLAY_NO_ENTRY ? NULL : &replay_entries[replay_slots[slot]];
+}
+
+/**
+ * Returns the number of responses in the open recording.
+ */
+size_t replay_count(void) {
+    return replay_entry_count;
+}
+
+void replay_close(void) {
+    if (replay_map) {
+        munmap(replay_map, replay_length);
+    }
+    free(replay_entries);
+    free(replay_slots);
+    replay_map = NULL;
+    replay_length = 0;
+    replay_entries = NULL;
+    replay_entry_count = 0;
+    replay_slots = NULL;
+    replay_slot_count = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Recorded crawl responses, for replaying a crawl without the network.
+// With --record every response (URL, HTTP status, transfer result, raw headers, body and
+// curl's phase timings) is appended to a file; with --replay the file is memory-mapped and
+// the crawler looks each URL up there instead of fetching it, so parser and scheduler
+// changes can be compared on exactly the same workload.
+// File layout: RECORDING_MAGIC, then per response a RecordingEntryHeader followed by the
+// URL, the headers and the body (not NUL-terminated).
+#define RECORDING_MAGIC "WCRECRD1"
+
+// Transfer phase timings in microseconds since the start of the transfer, as curl reports them
+typedef struct {
+    uint64_t dns;
+    uint64_t connect;
+    uint64_t tls;
+    uint64_t ttfb;
+    uint64_t total;
+} FetchTimings;
+
+typedef struct {
+    uint32_t url_length;
+    uint32_t header_length;
+    uint64_t body_length;
+    int32_t status;  // HTTP status code (0 if no response arrived)
+    int32_t result;  // CURLcode of the transfer
+    FetchTimings timings;
+} RecordingEntryHeader;
+
+// One response; when replaying, the strings point into the mapped file
+typedef struct {
+    const char *url;
+    size_t url_length;
+    const char *headers;
+    size_t header_length;
+    const char *body;
+    size_t body_length;
+    int status;
+    int result;
+    FetchTimings timings;
+} RecordedResponse;
+
+int recording_open(const char *path);
+int recording_add(const RecordedResponse *response);
+int recording_close(void);
+
+int replay_open(const char *path);
+const RecordedResponse *replay_find(const char *url);
+size_t replay_count(void);
+void replay_close(void);
+
+#endif
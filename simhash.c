@@ -0,0 +1,167 @@
+#include "simhash.h"
+#include "lock_profile.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SIMHASH_BUCKETS (1u << SIMHASH_BLOCK_BITS)
+
+/**
+ * 64-bit FNV-1a hash of a token, followed by a final avalanche so that
+ * short tokens still spread over all 64 bits.
+ */
+static uint64_t token_hash(const char *token, size_t length) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (unsigned char)token[i];
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void simhash_init(SimhashState *state) {
+    memset(state, 0, sizeof(*state));
+}
+
+/**
+ * Adds one token: every bit set in the token's hash votes +1, every clear bit votes -1.
+ */
+void simhash_add_token(SimhashState *state, const char *token, size_t length) {
+    uint64_t h = token_hash(token, length);
+    for (int bit = 0; bit < SIMHASH_BITS; bit++) {
+        state->weights[bit] += ((h >> bit) & 1) ? 1 : -1;
+    }
+}
+
+/**
+ * Collapses the votes into the final fingerprint: bit i is set when its total is positive.
+ */
+uint64_t simhash_final(const SimhashState *state) {
+    uint64_t h = 0;
+    for (int bit = 0; bit < SIMHASH_BITS; bit++) {
+        if (state->weights[bit] > 0) {
+            h |= 1ULL << bit;
+        }
+    }
+    return h;
+}
+
+/**
+ * Returns the Hamming distance between two fingerprints.
+ */
+int simhash_distance(uint64_t a, uint64_t b) {
+    uint64_t x = a ^ b;
+    int distance = 0;
+    while (x) {
+        x &= x - 1;
+        distance++;
+    }
+    return distance;
+}
+
+static uint32_t block_of(uint64_t hash, int table) {
+    return (uint32_t)((hash >> (table * SIMHASH_BLOCK_BITS)) & (SIMHASH_BUCKETS - 1));
+}
+
+/**
+ * Allocates the empty block tables. Returns 0 on success, -1 on allocation failure.
+ */
+int simhash_index_init(SimhashIndex *index) {
+    memset(index, 0, sizeof(*index));
+    for (int t = 0; t < SIMHASH_TABLES; t++) {
+        index->tables[t] = calloc(SIMHASH_BUCKETS, sizeof(SimhashBucket));
+        if (!index->tables[t]) {
+            simhash_index_destroy(index);
+            return -1;
+        }
+    }
+    pthread_mutex_init(&index->lock, NULL);
+    return 0;
+}
+
+static int bucket_push(SimhashBucket *bucket, uint32_t entry) {
+    if (bucket->count == bucket->capacity) {
+        uint32_t new_capacity = bucket->capacity ? bucket->capacity * 2 : 4;
+        uint32_t *grown = realloc(bucket->entries, new_capacity * sizeof(uint32_t));
+        if (!grown) {
+            return -1;
+        }
+        bucket->entries = grown;
+        bucket->capacity = new_capacity;
+    }
+    bucket->entries[bucket->count++] = entry;
+    return 0;
+}
+
+/**
+ * Looks for a stored fingerprint within SIMHASH_MAX_DISTANCE bits of `hash`, then adds `hash`
+ * for `page_index`. Only entries sharing at least one 16-bit block are compared, which by the
+ * pigeonhole principle includes every candidate within the distance limit.
+ * Returns 1 and sets *match_page if a near-duplicate was found, 0 if not, -1 on allocation failure.
+ */
+int simhash_index_add(SimhashIndex *index, uint64_t hash, int page_index, int *match_page) {
+    int found = 0;
+    MUTEX_LOCK(&index->lock);
+    for (int t = 0; t < SIMHASH_TABLES && !found; t++) {
+        const SimhashBucket *bucket = &index->tables[t][block_of(hash, t)];
+        for (uint32_t i = 0; i < bucket->count; i++) {
+            uint32_t entry = bucket->entries[i];
+            if (simhash_distance(index->hashes[entry], hash) <= SIMHASH_MAX_DISTANCE) {
+                *match_page = index->pages[entry];
+                found = 1;
+                break;
+            }
+        }
+    }
+
+    if (index->count == index->capacity) {
+        uint32_t new_capacity = index->capacity ? index->capacity * 2 : 1024;
+        uint64_t *hashes = realloc(index->hashes, new_capacity * sizeof(uint64_t));
+        if (hashes) {
+            index->hashes = hashes;
+        }
+        int *pages = realloc(index->pages, new_capacity * sizeof(int));
+        if (pages) {
+            index->pages = pages;
+        }
+        if (!hashes || !pages) {
+            MUTEX_UNLOCK(&index->lock);
+            return -1;
+        }
+        index->capacity = new_capacity;
+    }
+    uint32_t entry = index->count++;
+    index->hashes[entry] = hash;
+    index->pages[entry] = page_index;
+    for (int t = 0; t < SIMHASH_TABLES; t++) {
+        if (bucket_push(&index->tables[t][block_of(hash, t)], entry) != 0) {
+            MUTEX_UNLOCK(&index->lock);
+            return -1;
+        }
+    }
+    MUTEX_UNLOCK(&index->lock);
+    return found;
+}
+
+/**
+ * Frees every bucket and table of the index.
+ */
+void simhash_index_destroy(SimhashIndex *index) {
+    for (int t = 0; t < SIMHASH_TABLES; t++) {
+        if (!index->tables[t]) {
+            continue;
+        }
+        for (uint32_t b = 0; b < SIMHASH_BUCKETS; b++) {
+            free(index->tables[t][b].entries);
+        }
+        free(index->tables[t]);
+        index->tables[t] = NULL;
+    }
+    free(index->hashes);
+    free(index->pages);
+    index->hashes = NULL;
+    index->pages = NULL;
+    index->count = index->capacity = 0;
+}
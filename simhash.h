@@ -0,0 +1,46 @@
+#ifndef SIMHASH_H
+#define SIMHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// 64-bit SimHash over the text tokens of a page. Pages that differ only in small parts
+// (ads, timestamps, navigation) end up with fingerprints a few bits apart.
+#define SIMHASH_BITS 64
+#define SIMHASH_MAX_DISTANCE 3 // Pages at most this many bits apart count as near-duplicates
+#define SIMHASH_TABLES (SIMHASH_MAX_DISTANCE + 1) // Pigeonhole: one 16-bit block always matches exactly
+#define SIMHASH_BLOCK_BITS (SIMHASH_BITS / SIMHASH_TABLES)
+
+// Running per-bit weights while tokens are added
+typedef struct {
+    int32_t weights[SIMHASH_BITS];
+} SimhashState;
+
+// Bucket of entry numbers sharing one block value
+typedef struct {
+    uint32_t *entries;
+    uint32_t count;
+    uint32_t capacity;
+} SimhashBucket;
+
+// Multi-table index answering "is there a stored hash within SIMHASH_MAX_DISTANCE bits?"
+typedef struct {
+    uint64_t *hashes;  // Stored hashes, by entry number
+    int *pages;        // Page number owning each entry
+    uint32_t count;
+    uint32_t capacity;
+    SimhashBucket *tables[SIMHASH_TABLES]; // One table per block, indexed by block value
+    pthread_mutex_t lock;
+} SimhashIndex;
+
+void simhash_init(SimhashState *state);
+void simhash_add_token(SimhashState *state, const char *token, size_t length);
+uint64_t simhash_final(const SimhashState *state);
+int simhash_distance(uint64_t a, uint64_t b);
+
+int simhash_index_init(SimhashIndex *index);
+int simhash_index_add(SimhashIndex *index, uint64_t hash, int page_index, int *match_page);
+void simhash_index_destroy(SimhashIndex *index);
+
+#endif
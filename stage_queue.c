@@ -0,0 +1,80 @@
+#include "stage_queue.h"
+#include "lock_profile.h"
+#include <stdlib.h>
+
+/**
+ * Allocates an empty queue holding at most `capacity` items. Returns 0 on success, -1 on failure.
+ */
+int stage_queue_init(StageQueue *queue, size_t capacity, const char *name) {
+    queue->items = malloc(capacity * sizeof(void *));
+    if (!queue->items) {
+        return -1;
+    }
+    queue->capacity = capacity;
+    queue->head = queue->count = 0;
+    queue->closed = 0;
+    queue->name = name;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    return 0;
+}
+
+/**
+ * Appends an item, waiting while the queue is full.
+ * Returns 0 on success, -1 if the queue was closed (the item is not added).
+ */
+int stage_queue_push(StageQueue *queue, void *item) {
+    MUTEX_LOCK_NAMED(&queue->lock, queue->name);
+    while (queue->count == queue->capacity && !queue->closed) {
+        COND_WAIT(&queue->not_full, &queue->lock);
+    }
+    if (queue->closed) {
+        MUTEX_UNLOCK(&queue->lock);
+        return -1;
+    }
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    MUTEX_UNLOCK(&queue->lock);
+    return 0;
+}
+
+/**
+ * Removes the oldest item, waiting while the queue is empty.
+ * Returns NULL once the queue is closed and empty.
+ */
+void *stage_queue_pop(StageQueue *queue) {
+    MUTEX_LOCK_NAMED(&queue->lock, queue->name);
+    while (queue->count == 0 && !queue->closed) {
+        COND_WAIT(&queue->not_empty, &queue->lock);
+    }
+    void *item = NULL;
+    if (queue->count > 0) {
+        item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+    }
+    MUTEX_UNLOCK(&queue->lock);
+    return item;
+}
+
+/**
+ * Closes the queue: waiting producers give up, and consumers get NULL once it is drained.
+ */
+void stage_queue_close(StageQueue *queue) {
+    MUTEX_LOCK_NAMED(&queue->lock, queue->name);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_cond_broadcast(&queue->not_full);
+    MUTEX_UNLOCK(&queue->lock);
+}
+
+void stage_queue_destroy(StageQueue *queue) {
+    free(queue->items);
+    queue->items = NULL;
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+}
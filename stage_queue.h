@@ -0,0 +1,29 @@
+#ifndef STAGE_QUEUE_H
+#define STAGE_QUEUE_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+// Bounded blocking FIFO of pointers connecting two stages of the crawl pipeline.
+// Producers wait while it is full, so a slow stage holds back the stages feeding it
+// instead of letting pages pile up in memory. Closing the queue lets consumers drain
+// what is left and then stop.
+typedef struct {
+    void **items;     // Ring buffer of `capacity` items
+    size_t capacity;
+    size_t head;      // Next item to pop
+    size_t count;
+    int closed;
+    const char *name; // Names the queue's lock in the lock profile
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} StageQueue;
+
+int stage_queue_init(StageQueue *queue, size_t capacity, const char *name);
+int stage_queue_push(StageQueue *queue, void *item);
+void *stage_queue_pop(StageQueue *queue);
+void stage_queue_close(StageQueue *queue);
+void stage_queue_destroy(StageQueue *queue);
+
+#endif
@@ -0,0 +1,171 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like pthread_condattr_setclock
+#define _POSIX_C_SOURCE 200809L
+#include "timer_wheel.h"
+#include "lock_profile.h"
+#include <time.h>
+
+#define LEVEL_SHIFT(level) ((level) * TIMER_WHEEL_BITS)
+// Furthest ahead a timer can be placed without its top-level slot wrapping around
+#define MAX_DELAY_TICKS ((uint64_t)(TIMER_WHEEL_SLOTS - 1) << LEVEL_SHIFT(TIMER_WHEEL_LEVELS - 1))
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Puts a timer in its slot: the lowest level whose span (from the current tick) reaches its
+ * due tick. Must be called with the lock held.
+ */
+static void place(TimerWheel *wheel, TimerEntry *entry) {
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           (entry->due >> LEVEL_SHIFT(level + 1)) != (wheel->tick >> LEVEL_SHIFT(level + 1))) {
+        level++;
+    }
+    TimerEntry **slot = &wheel->slots[level][(entry->due >> LEVEL_SHIFT(level)) & (TIMER_WHEEL_SLOTS - 1)];
+    entry->next = *slot;
+    *slot = entry;
+}
+
+/**
+ * Advances the wheel by one tick: every higher-level slot whose span starts at the new tick
+ * is spread over the levels below, then the timers due at the tick are moved to `expired`.
+ * Must be called with the lock held.
+ */
+static void advance(TimerWheel *wheel, TimerEntry **expired) {
+    wheel->tick++;
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        if (wheel->tick & (((uint64_t)1 << LEVEL_SHIFT(level)) - 1)) {
+            break; // Not at a boundary of this level, so not of any higher one either
+        }
+        TimerEntry **slot = &wheel->slots[level][(wheel->tick >> LEVEL_SHIFT(level)) & (TIMER_WHEEL_SLOTS - 1)];
+        TimerEntry *entry = *slot;
+        *slot = NULL;
+        while (entry) {
+            TimerEntry *next = entry->next;
+            place(wheel, entry);
+            entry = next;
+        }
+    }
+    TimerEntry **slot = &wheel->slots[0][wheel->tick & (TIMER_WHEEL_SLOTS - 1)];
+    while (*slot) {
+        TimerEntry *entry = *slot;
+        *slot = entry->next;
+        entry->next = *expired;
+        *expired = entry;
+        wheel->count--;
+    }
+}
+
+/**
+ * The next tick at which advance has work to do: the next non-empty level 0 slot, or else
+ * the next time level 1 is spread out (timers further ahead are only looked at then).
+ * Must be called with the lock held and at least one timer waiting.
+ */
+static uint64_t next_event(const TimerWheel *wheel) {
+    for (uint64_t tick = wheel->tick + 1; tick < wheel->tick + TIMER_WHEEL_SLOTS; tick++) {
+        if ((tick & (TIMER_WHEEL_SLOTS - 1)) == 0) {
+            break; // Level 1 is spread out here anyway
+        }
+        if (wheel->slots[0][tick & (TIMER_WHEEL_SLOTS - 1)]) {
+            return tick;
+        }
+    }
+    return ((wheel->tick >> TIMER_WHEEL_BITS) + 1) << TIMER_WHEEL_BITS;
+}
+
+/**
+ * Prepares an empty wheel whose ticks are `tick_ms` milliseconds long.
+ * Returns 0 on success, -1 on failure.
+ */
+int timer_wheel_init(TimerWheel *wheel, uint64_t tick_ms) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            wheel->slots[level][slot] = NULL;
+        }
+    }
+    wheel->tick = 0;
+    wheel->tick_ns = (tick_ms > 0 ? tick_ms : 1) * 1000000ULL;
+    wheel->start_ns = now_ns();
+    wheel->count = 0;
+    wheel->closed = 0;
+    pthread_condattr_t attr;
+    if (pthread_condattr_init(&attr) != 0) {
+        return -1;
+    }
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int failed = pthread_mutex_init(&wheel->lock, NULL) != 0;
+    if (!failed && pthread_cond_init(&wheel->changed, &attr) != 0) {
+        pthread_mutex_destroy(&wheel->lock);
+        failed = 1;
+    }
+    pthread_condattr_destroy(&attr);
+    return failed ? -1 : 0;
+}
+
+/**
+ * Schedules `entry` to be returned by timer_wheel_wait `delay_ms` milliseconds from now,
+ * rounded up to whole ticks (and capped at the span of the wheel). The entry must stay
+ * valid until then. Safe to call from any thread.
+ */
+void timer_wheel_add(TimerWheel *wheel, TimerEntry *entry, uint64_t delay_ms) {
+    uint64_t delay = (delay_ms * 1000000ULL + wheel->tick_ns - 1) / wheel->tick_ns;
+    MUTEX_LOCK_NAMED(&wheel->lock, "timer wheel");
+    // Ticks that have passed but not been advanced over yet still count as the present
+    uint64_t now = (now_ns() - wheel->start_ns) / wheel->tick_ns;
+    uint64_t ahead = now > wheel->tick ? now - wheel->tick : 0;
+    delay += ahead;
+    entry->due = wheel->tick + (delay < 1 ? 1 : delay > MAX_DELAY_TICKS ? MAX_DELAY_TICKS : delay);
+    place(wheel, entry);
+    wheel->count++;
+    pthread_cond_signal(&wheel->changed); // The waiter may need to wake up earlier
+    MUTEX_UNLOCK(&wheel->lock);
+}
+
+/**
+ * Waits until at least one timer is due and returns all due timers as a list linked
+ * through `next`, or NULL once the wheel is closed. Timers still waiting at that point
+ * stay with their owners. Meant for a single thread driving the wheel.
+ */
+TimerEntry *timer_wheel_wait(TimerWheel *wheel) {
+    TimerEntry *expired = NULL;
+    MUTEX_LOCK_NAMED(&wheel->lock, "timer wheel");
+    while (!wheel->closed) {
+        uint64_t now = (now_ns() - wheel->start_ns) / wheel->tick_ns;
+        if (wheel->count == 0 && now > wheel->tick) {
+            wheel->tick = now; // Nothing to expire in between
+        }
+        while (wheel->tick < now && wheel->count > 0) {
+            advance(wheel, &expired);
+        }
+        if (expired) {
+            break;
+        }
+        if (wheel->count == 0) {
+            COND_WAIT(&wheel->changed, &wheel->lock);
+        } else {
+            uint64_t wake = wheel->start_ns + next_event(wheel) * wheel->tick_ns;
+            struct timespec deadline = {(time_t)(wake / 1000000000ULL), (long)(wake % 1000000000ULL)};
+            COND_TIMEDWAIT(&wheel->changed, &wheel->lock, &deadline);
+        }
+    }
+    MUTEX_UNLOCK(&wheel->lock);
+    return expired;
+}
+
+/**
+ * Makes timer_wheel_wait return NULL from now on.
+ */
+void timer_wheel_close(TimerWheel *wheel) {
+    MUTEX_LOCK_NAMED(&wheel->lock, "timer wheel");
+    wheel->closed = 1;
+    pthread_cond_broadcast(&wheel->changed);
+    MUTEX_UNLOCK(&wheel->lock);
+}
+
+void timer_wheel_destroy(TimerWheel *wheel) {
+    pthread_mutex_destroy(&wheel->lock);
+    pthread_cond_destroy(&wheel->changed);
+}
@@ -0,0 +1,41 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Hierarchical timer wheel (Varghese and Lauck) for work that is due later, such as
+// fetch retries. Time advances in ticks; level 0 has one slot per tick, and each higher
+// level has one slot per full turn of the level below, so adding a timer is O(1) however
+// far ahead it is due, and a timer is moved down a level at most TIMER_WHEEL_LEVELS - 1
+// times before it expires. A single thread waits in timer_wheel_wait for whatever falls
+// due, instead of a thread sleeping per timer.
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4 // 64^4 ticks: over 4 hours with 10 ms ticks
+
+// Embedded in the caller's own struct (as its first member, so the struct can be cast back)
+typedef struct TimerEntry {
+    struct TimerEntry *next;
+    uint64_t due; // Tick at which the timer expires
+} TimerEntry;
+
+typedef struct {
+    TimerEntry *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t tick;      // Current tick; every timer due at or before it has expired
+    uint64_t tick_ns;   // Length of a tick
+    uint64_t start_ns;  // Monotonic time of tick 0
+    size_t count;       // Timers waiting
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed; // Signaled when a timer is added or the wheel is closed
+} TimerWheel;
+
+int timer_wheel_init(TimerWheel *wheel, uint64_t tick_ms);
+void timer_wheel_add(TimerWheel *wheel, TimerEntry *entry, uint64_t delay_ms);
+TimerEntry *timer_wheel_wait(TimerWheel *wheel);
+void timer_wheel_close(TimerWheel *wheel);
+void timer_wheel_destroy(TimerWheel *wheel);
+
+#endif
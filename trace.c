@@ -0,0 +1,165 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like clock_gettime
+#define _POSIX_C_SOURCE 200809L
+#include "trace.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// One finished span. Names and categories are string literals, so only pointers are kept.
+typedef struct {
+    const char *name;
+    const char *category;
+    uint64_t start;
+    uint64_t end;
+    long page;
+} TraceSpan;
+
+// Spans recorded by one thread
+typedef struct TraceBuffer {
+    TraceSpan *spans;
+    size_t count;
+    size_t capacity;
+    uint32_t thread;
+    const char *thread_name;
+    struct TraceBuffer *next; // Next buffer in the registry
+} TraceBuffer;
+
+int trace_enabled = 0;
+static _Atomic(TraceBuffer *) buffers = NULL; // Registry of all thread buffers (push-only list)
+static _Thread_local TraceBuffer *thread_buffer = NULL;
+static atomic_uint thread_count = 0;
+static uint64_t trace_origin; // Timestamp written as time 0
+
+/**
+ * Turns tracing on. Must be called before the threads to be traced start.
+ * Returns 0 on success.
+ */
+int trace_start(void) {
+    trace_enabled = 1;
+    trace_origin = trace_now();
+    return 0;
+}
+
+/**
+ * Returns the current monotonic time in nanoseconds, or 0 while tracing is off.
+ */
+uint64_t trace_now(void) {
+    if (!trace_enabled) {
+        return 0;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Returns the calling thread's buffer, creating and registering it on first use.
+ */
+static TraceBuffer *get_buffer(void) {
+    if (thread_buffer) {
+        return thread_buffer;
+    }
+    TraceBuffer *buffer = calloc(1, sizeof(TraceBuffer));
+    if (!buffer) {
+        return NULL;
+    }
+    buffer->thread = atomic_fetch_add(&thread_count, 1);
+    buffer->next = atomic_load(&buffers);
+    while (!atomic_compare_exchange_weak(&buffers, &buffer->next, buffer)) {
+        // buffer->next was refreshed with the current list head; retry
+    }
+    thread_buffer = buffer;
+    return buffer;
+}
+
+/**
+ * Names the calling thread in the trace (the string must outlive the trace).
+ */
+void trace_thread_name(const char *name) {
+    if (!trace_enabled) {
+        return;
+    }
+    TraceBuffer *buffer = get_buffer();
+    if (buffer) {
+        buffer->thread_name = name;
+    }
+}
+
+/**
+ * Records a span of the calling thread from `start` to `end` (trace_now timestamps).
+ * `page` is attached as an argument unless it is TRACE_NO_PAGE.
+ */
+void trace_span(const char *name, const char *category, uint64_t start, uint64_t end, long page) {
+    if (!trace_enabled) {
+        return;
+    }
+    TraceBuffer *buffer = get_buffer();
+    if (!buffer) {
+        return;
+    }
+    if (buffer->count == buffer->capacity) {
+        if (buffer->capacity == TRACE_MAX_SPANS_PER_THREAD) {
+            return;
+        }
+        size_t new_capacity = buffer->capacity ? buffer->capacity * 2 : 1024;
+        TraceSpan *spans = realloc(buffer->spans, new_capacity * sizeof(TraceSpan));
+        if (!spans) {
+            return;
+        }
+        buffer->spans = spans;
+        buffer->capacity = new_capacity;
+    }
+    buffer->spans[buffer->count++] = (TraceSpan){name, category, start, end, page};
+}
+
+/**
+ * Writes every recorded span to `path` as Chrome trace JSON ("X" complete events,
+ * microsecond timestamps, one tid per traced thread).
+ * Must be called after the traced threads have finished. Returns 0 on success, -1 on failure.
+ */
+int trace_write(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return -1;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"crawler\"}}");
+    for (TraceBuffer *buffer = atomic_load(&buffers); buffer; buffer = buffer->next) {
+        if (buffer->thread_name) {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+                    buffer->thread, buffer->thread_name, buffer->thread);
+        }
+        for (size_t i = 0; i < buffer->count; i++) {
+            const TraceSpan *span = &buffer->spans[i];
+            uint64_t start = span->start > trace_origin ? span->start - trace_origin : 0;
+            uint64_t duration = span->end > span->start ? span->end - span->start : 0;
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                    span->name, span->category, buffer->thread, start / 1000.0, duration / 1000.0);
+            if (span->page != TRACE_NO_PAGE) {
+                fprintf(file, ",\"args\":{\"page\":%ld}", span->page);
+            }
+            fputc('}', file);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    if (ferror(file)) {
+        fclose(file);
+        return -1;
+    }
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+/**
+ * Frees every thread's buffer. Must be called after all traced threads have finished.
+ */
+void trace_destroy(void) {
+    TraceBuffer *buffer = atomic_exchange(&buffers, NULL);
+    while (buffer) {
+        TraceBuffer *next = buffer->next;
+        free(buffer->spans);
+        free(buffer);
+        buffer = next;
+    }
+    thread_buffer = NULL;
+}
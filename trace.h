@@ -0,0 +1,22 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Opt-in crawl timeline. Threads record complete spans (name, start, end, page) into
+// their own buffers without locking; at the end the spans are written as Chrome trace
+// JSON, which chrome://tracing and ui.perfetto.dev open directly.
+// While tracing is off every call returns after a single branch.
+#define TRACE_MAX_SPANS_PER_THREAD (1 << 20) // Later spans of a thread are dropped
+#define TRACE_NO_PAGE -1
+
+extern int trace_enabled;
+
+int trace_start(void);
+uint64_t trace_now(void);
+void trace_thread_name(const char *name);
+void trace_span(const char *name, const char *category, uint64_t start, uint64_t end, long page);
+int trace_write(const char *path);
+void trace_destroy(void);
+
+#endif
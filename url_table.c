@@ -0,0 +1,169 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like strdup
+#define _POSIX_C_SOURCE 200809L
+#include "url_table.h"
+#include "lock_profile.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * 64-bit FNV-1a hash of a NUL-terminated URL.
+ */
+uint64_t url_hash(const char *url) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const unsigned char *p = (const unsigned char *)url; *p; p++) {
+        h ^= *p;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/**
+ * Allocates an empty table. Returns 0 on success, -1 on allocation failure.
+ */
+int url_table_init(UrlTable *table) {
+    memset(table, 0, sizeof(*table));
+    table->slot_capacity = 1024;
+    table->slots = malloc(table->slot_capacity * sizeof(uint32_t));
+    table->slot_hashes = malloc(table->slot_capacity * sizeof(uint64_t));
+    if (!table->slots || !table->slot_hashes) {
+        url_table_destroy(table);
+        return -1;
+    }
+    memset(table->slots, 0xff, table->slot_capacity * sizeof(uint32_t)); // All URL_ID_NONE
+    pthread_mutex_init(&table->lock, NULL);
+    return 0;
+}
+
+/**
+ * Finds the slot holding `url`, or the empty slot where it would be inserted.
+ */
+static size_t find_slot(const UrlTable *table, const uint32_t *slots, const uint64_t *hashes,
+                        size_t capacity, uint64_t hash, const char *url) {
+    size_t i = (size_t)hash & (capacity - 1);
+    while (slots[i] != URL_ID_NONE &&
+           (hashes[i] != hash || (url && strcmp(table->urls[slots[i]], url) != 0))) {
+        i = (i + 1) & (capacity - 1); // Linear probing
+    }
+    return i;
+}
+
+/**
+ * Doubles the hash table, re-inserting every id by its cached hash.
+ */
+static int grow_slots(UrlTable *table) {
+    size_t new_capacity = table->slot_capacity * 2;
+    uint32_t *slots = malloc(new_capacity * sizeof(uint32_t));
+    uint64_t *hashes = malloc(new_capacity * sizeof(uint64_t));
+    if (!slots || !hashes) {
+        free(slots);
+        free(hashes);
+        return -1;
+    }
+    memset(slots, 0xff, new_capacity * sizeof(uint32_t));
+    for (size_t i = 0; i < table->slot_capacity; i++) {
+        if (table->slots[i] != URL_ID_NONE) {
+            // Ids are unique, so no string comparison is needed while rehashing
+            size_t j = find_slot(table, slots, hashes, new_capacity, table->slot_hashes[i], NULL);
+            slots[j] = table->slots[i];
+            hashes[j] = table->slot_hashes[i];
+        }
+    }
+    free(table->slots);
+    free(table->slot_hashes);
+    table->slots = slots;
+    table->slot_hashes = hashes;
+    table->slot_capacity = new_capacity;
+    return 0;
+}
+
+/**
+ * Returns the id of `url`, assigning the next free id if the URL has not been seen before.
+ * If `is_new` is not NULL it is set to 1 when the id was just assigned and 0 otherwise.
+ * Returns URL_ID_NONE on allocation failure.
+ */
+uint32_t url_table_insert(UrlTable *table, const char *url, int *is_new) {
+    uint64_t hash = url_hash(url);
+    MUTEX_LOCK(&table->lock);
+    size_t i = find_slot(table, table->slots, table->slot_hashes, table->slot_capacity, hash, url);
+    if (table->slots[i] != URL_ID_NONE) {
+        uint32_t id = table->slots[i];
+        MUTEX_UNLOCK(&table->lock);
+        if (is_new) *is_new = 0;
+        return id;
+    }
+
+    if ((table->count + 1) * 2 > table->slot_capacity) {
+        if (grow_slots(table) != 0) {
+            MUTEX_UNLOCK(&table->lock);
+            return URL_ID_NONE;
+        }
+        i = find_slot(table, table->slots, table->slot_hashes, table->slot_capacity, hash, url);
+    }
+    if (table->count == table->urls_capacity) {
+        uint32_t new_capacity = table->urls_capacity ? table->urls_capacity * 2 : 1024;
+        char **urls = realloc(table->urls, new_capacity * sizeof(char *));
+        if (!urls) {
+            MUTEX_UNLOCK(&table->lock);
+            return URL_ID_NONE;
+        }
+        table->urls = urls;
+        table->urls_capacity = new_capacity;
+    }
+    char *copy = strdup(url);
+    if (!copy || table->count == URL_ID_NONE - 1) {
+        free(copy);
+        MUTEX_UNLOCK(&table->lock);
+        return URL_ID_NONE;
+    }
+    uint32_t id = table->count++;
+    table->urls[id] = copy;
+    table->slots[i] = id;
+    table->slot_hashes[i] = hash;
+    MUTEX_UNLOCK(&table->lock);
+    if (is_new) *is_new = 1;
+    return id;
+}
+
+/**
+ * Same as url_table_insert without reporting whether the URL was new.
+ */
+uint32_t url_table_intern(UrlTable *table, const char *url) {
+    return url_table_insert(table, url, NULL);
+}
+
+/**
+ * Returns the URL string of an id. Strings stay valid until the table is destroyed.
+ */
+const char *url_table_get(UrlTable *table, uint32_t id) {
+    MUTEX_LOCK(&table->lock);
+    const char *url = id < table->count ? table->urls[id] : NULL;
+    MUTEX_UNLOCK(&table->lock);
+    return url;
+}
+
+/**
+ * Returns the number of distinct URLs interned so far.
+ */
+uint32_t url_table_count(UrlTable *table) {
+    MUTEX_LOCK(&table->lock);
+    uint32_t count = table->count;
+    MUTEX_UNLOCK(&table->lock);
+    return count;
+}
+
+/**
+ * Frees every URL string and the hash table.
+ */
+void url_table_destroy(UrlTable *table) {
+    for (uint32_t i = 0; i < table->count; i++) {
+        free(table->urls[i]);
+    }
+    free(table->urls);
+    free(table->slots);
+    free(table->slot_hashes);
+    table->urls = NULL;
+    table->slots = NULL;
+    table->slot_hashes = NULL;
+    table->count = table->urls_capacity = 0;
+    table->slot_capacity = 0;
+}
@@ -0,0 +1,29 @@
+#ifndef URL_TABLE_H
+#define URL_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define URL_ID_NONE UINT32_MAX // Returned when a URL could not be interned
+
+// Thread-safe dictionary assigning a dense id (0, 1, 2, ...) to every distinct URL
+typedef struct {
+    char **urls;       // URL string of each id
+    uint32_t count;
+    uint32_t urls_capacity;
+    uint32_t *slots;   // Open-addressing hash table of ids (URL_ID_NONE = empty)
+    uint64_t *slot_hashes; // Full hash of the URL in each slot, to skip most string compares
+    size_t slot_capacity;  // Always a power of two
+    pthread_mutex_t lock;
+} UrlTable;
+
+int url_table_init(UrlTable *table);
+uint32_t url_table_intern(UrlTable *table, const char *url);
+uint32_t url_table_insert(UrlTable *table, const char *url, int *is_new);
+const char *url_table_get(UrlTable *table, uint32_t id);
+uint32_t url_table_count(UrlTable *table);
+void url_table_destroy(UrlTable *table);
+uint64_t url_hash(const char *url);
+
+#endif
@@ -0,0 +1,69 @@
+// Tell compiler to use POSIX.1-2008 and later for APIs like strdup
+#define _POSIX_C_SOURCE 200809L
+#include "visited_set.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Initializes an empty set with room for `capacity` URLs. Returns 0 on success, -1 if memory runs out.
+ */
+int visited_set_init(VisitedSet *set, size_t capacity) {
+    set->urls = calloc(capacity, sizeof(char *));
+    set->count = 0;
+    set->capacity = set->urls ? capacity : 0;
+    return set->urls ? 0 : -1;
+}
+
+/**
+ * Returns 1 if the URL is in the set, 0 otherwise.
+ */
+int visited_set_contains(const VisitedSet *set, const char *url) {
+    for (size_t i = 0; i < set->count; i++) {
+        if (strcmp(set->urls[i], url) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Adds a URL unless it is already in the set.
+ * Returns 1 if the URL was already visited, 0 otherwise (it is remembered while there is room).
+ */
+int visited_set_add(VisitedSet *set, const char *url) {
+    if (visited_set_contains(set, url)) {
+        return 1;
+    }
+    if (set->count < set->capacity) {
+        char *copy = strdup(url);
+        if (copy) {
+            set->urls[set->count++] = copy;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Adds a batch of URLs, so callers lock once per page instead of once per link.
+ * Compacts `urls` to the ones that were not visited yet (a URL repeated within the batch
+ * counts as visited after its first occurrence), keeping their order, and returns how
+ * many there are.
+ */
+size_t visited_set_add_new(VisitedSet *set, const char *urls[], size_t count) {
+    size_t fresh = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!visited_set_add(set, urls[i])) {
+            urls[fresh++] = urls[i];
+        }
+    }
+    return fresh;
+}
+
+void visited_set_destroy(VisitedSet *set) {
+    for (size_t i = 0; i < set->count; i++) {
+        free(set->urls[i]);
+    }
+    free(set->urls);
+    set->urls = NULL;
+    set->count = set->capacity = 0;
+}
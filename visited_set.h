@@ -0,0 +1,20 @@
+#ifndef VISITED_SET_H
+#define VISITED_SET_H
+
+#include <stddef.h>
+
+// Set of the URLs already queued for crawling. Holds at most `capacity` URLs; once full,
+// new URLs are reported as unvisited but not remembered. Not thread-safe: callers lock.
+typedef struct {
+    char **urls;
+    size_t count;
+    size_t capacity;
+} VisitedSet;
+
+int visited_set_init(VisitedSet *set, size_t capacity);
+int visited_set_contains(const VisitedSet *set, const char *url);
+int visited_set_add(VisitedSet *set, const char *url);
+size_t visited_set_add_new(VisitedSet *set, const char *urls[], size_t count);
+void visited_set_destroy(VisitedSet *set);
+
+#endif
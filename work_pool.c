@@ -0,0 +1,246 @@
+#include "work_pool.h"
+#include "lock_profile.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WORK_STEAL_ROUNDS 2 // Passes over all victims before a worker parks
+
+/**
+ * Owner only: pushes a task at the bottom. Returns 0 on success, -1 if the deque is full.
+ */
+static int deque_push(WorkDeque *deque, void *task) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (bottom - top >= WORK_DEQUE_CAPACITY) {
+        return -1;
+    }
+    atomic_store_explicit(&deque->slots[bottom & (WORK_DEQUE_CAPACITY - 1)], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * Owner only: takes the most recently pushed task. Returns NULL if the deque is empty.
+ */
+static void *deque_take(WorkDeque *deque) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed); // Was empty
+        return NULL;
+    }
+    void *task = atomic_load_explicit(&deque->slots[bottom & (WORK_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+    if (top == bottom) {
+        // Last task: race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst,
+                                                     memory_order_relaxed)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+/**
+ * Any thread: steals the oldest task. Returns NULL if the deque is empty or another
+ * thread won the race for the task.
+ */
+static void *deque_steal(WorkDeque *deque) {
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) {
+        return NULL;
+    }
+    void *task = atomic_load_explicit(&deque->slots[top & (WORK_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return NULL;
+    }
+    return task;
+}
+
+static int deque_is_empty(WorkDeque *deque) {
+    return atomic_load_explicit(&deque->top, memory_order_acquire) >=
+           atomic_load_explicit(&deque->bottom, memory_order_acquire);
+}
+
+/**
+ * Allocates a pool for `workers` workers (numbered 0 to workers - 1) with an injector
+ * holding at most `injector_capacity` tasks. Returns 0 on success, -1 on failure.
+ */
+int work_pool_init(WorkPool *pool, int workers, size_t injector_capacity) {
+    memset(pool, 0, sizeof(*pool));
+    pool->deques = aligned_alloc(_Alignof(WorkDeque), workers * sizeof(WorkDeque));
+    pool->rng = malloc(workers * sizeof(uint64_t));
+    pool->injector = malloc(injector_capacity * sizeof(void *));
+    if (!pool->deques || !pool->rng || !pool->injector) {
+        free(pool->deques);
+        free(pool->rng);
+        free(pool->injector);
+        return -1;
+    }
+    for (int i = 0; i < workers; i++) {
+        atomic_init(&pool->deques[i].top, 0);
+        atomic_init(&pool->deques[i].bottom, 0);
+        pool->rng[i] = 0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1);
+    }
+    pool->workers = workers;
+    pool->capacity = injector_capacity;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->not_full, NULL);
+    return 0;
+}
+
+/**
+ * Submits a task from outside the pool, waiting while the injector is full.
+ * Returns 0 on success, -1 if the pool was closed (the task is not added).
+ */
+int work_pool_submit(WorkPool *pool, void *task) {
+    MUTEX_LOCK_NAMED(&pool->lock, "work pool injector");
+    while (pool->count == pool->capacity && !pool->closed) {
+        COND_WAIT(&pool->not_full, &pool->lock);
+    }
+    if (pool->closed) {
+        MUTEX_UNLOCK(&pool->lock);
+        return -1;
+    }
+    pool->injector[(pool->head + pool->count) % pool->capacity] = task;
+    pool->count++;
+    if (pool->sleepers > 0) {
+        pthread_cond_signal(&pool->wake);
+    }
+    MUTEX_UNLOCK(&pool->lock);
+    return 0;
+}
+
+/**
+ * Moves a share of the injector into the worker's deque and returns one task, or NULL if
+ * the injector is empty. Must be called with the pool lock held and the worker's deque
+ * empty (WORK_BATCH_MAX is below WORK_DEQUE_CAPACITY, so the batch always fits).
+ */
+static void *take_injected(WorkPool *pool, int worker) {
+    if (pool->count == 0) {
+        return NULL;
+    }
+    // Take an even share, so one worker does not hoard the backlog
+    size_t batch = pool->count / pool->workers + 1;
+    if (batch > WORK_BATCH_MAX) {
+        batch = WORK_BATCH_MAX;
+    }
+    if (batch > pool->count) {
+        batch = pool->count;
+    }
+    // The owner takes from the bottom of its deque, so the batch is pushed newest first to
+    // keep pages in submission (crawl) order
+    void *first = pool->injector[pool->head];
+    for (size_t i = batch - 1; i > 0; i--) {
+        deque_push(&pool->deques[worker], pool->injector[(pool->head + i) % pool->capacity]);
+    }
+    pool->head = (pool->head + batch) % pool->capacity;
+    pool->count -= batch;
+    pthread_cond_broadcast(&pool->not_full);
+    if (batch > 1 && pool->sleepers > 0) {
+        pthread_cond_signal(&pool->wake); // The rest of the batch can be stolen
+    }
+    return first;
+}
+
+/**
+ * Tries to steal a task from the other workers, starting at a random victim.
+ */
+static void *steal(WorkPool *pool, int worker) {
+    uint64_t *state = &pool->rng[worker];
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    int start = (int)(*state % (uint64_t)pool->workers);
+    for (int round = 0; round < WORK_STEAL_ROUNDS; round++) {
+        for (int i = 0; i < pool->workers; i++) {
+            int victim = (start + i) % pool->workers;
+            if (victim == worker) {
+                continue;
+            }
+            void *task = deque_steal(&pool->deques[victim]);
+            if (task) {
+                return task;
+            }
+        }
+    }
+    return NULL;
+}
+
+static int all_deques_empty(WorkPool *pool) {
+    for (int i = 0; i < pool->workers; i++) {
+        if (!deque_is_empty(&pool->deques[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Returns the next task for `worker`: from its own deque, else from the injector, else
+ * stolen from another worker. Parks while there is no work anywhere.
+ * Returns NULL once the pool is closed and all work is done.
+ */
+void *work_pool_next(WorkPool *pool, int worker) {
+    while (1) {
+        void *task = deque_take(&pool->deques[worker]);
+        if (task) {
+            return task;
+        }
+        MUTEX_LOCK_NAMED(&pool->lock, "work pool injector");
+        task = take_injected(pool, worker);
+        MUTEX_UNLOCK(&pool->lock);
+        if (task) {
+            return task;
+        }
+        task = steal(pool, worker);
+        if (task) {
+            return task;
+        }
+
+        // Park. A worker that publishes stealable tasks signals `wake` under the lock
+        // after pushing them, so checking the deques under the lock loses no wakeups.
+        MUTEX_LOCK_NAMED(&pool->lock, "work pool injector");
+        if (pool->count == 0 && all_deques_empty(pool)) {
+            if (pool->closed) {
+                MUTEX_UNLOCK(&pool->lock);
+                return NULL;
+            }
+            pool->sleepers++;
+            COND_WAIT(&pool->wake, &pool->lock);
+            pool->sleepers--;
+        }
+        MUTEX_UNLOCK(&pool->lock);
+    }
+}
+
+/**
+ * Closes the pool: submitters give up, and workers return NULL once all work is done.
+ */
+void work_pool_close(WorkPool *pool) {
+    MUTEX_LOCK_NAMED(&pool->lock, "work pool injector");
+    pool->closed = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_cond_broadcast(&pool->not_full);
+    MUTEX_UNLOCK(&pool->lock);
+}
+
+void work_pool_destroy(WorkPool *pool) {
+    free(pool->deques);
+    free(pool->rng);
+    free(pool->injector);
+    pool->deques = NULL;
+    pool->rng = NULL;
+    pool->injector = NULL;
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->not_full);
+}
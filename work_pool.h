@@ -0,0 +1,46 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Work-stealing scheduler for CPU tasks.
+// Every worker owns a Chase-Lev deque: it pushes and takes tasks at the bottom without
+// locking, while idle workers steal from the top of a randomly chosen victim with a single
+// CAS. Tasks from outside the pool (the fetch threads) go into a bounded injector queue;
+// a worker whose deque is empty takes a share of the injector at once (one lock for many
+// tasks) and parks only when the injector and every deque are empty.
+#define WORK_DEQUE_CAPACITY 256 // Power of two
+#define WORK_BATCH_MAX 32       // Most tasks a worker moves from the injector at once
+
+// Chase-Lev deque (Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models").
+// Indices only grow; slot i lives at i % WORK_DEQUE_CAPACITY.
+typedef struct {
+    _Alignas(64) _Atomic int64_t top;    // Next task to steal
+    _Alignas(64) _Atomic int64_t bottom; // Next free slot, owned by the worker
+    _Atomic(void *) slots[WORK_DEQUE_CAPACITY];
+} WorkDeque;
+
+typedef struct {
+    WorkDeque *deques;  // One per worker
+    uint64_t *rng;      // Per-worker victim selection state
+    int workers;
+    void **injector;    // Ring buffer of tasks submitted from outside the pool
+    size_t capacity;
+    size_t head;
+    size_t count;
+    int sleepers;       // Workers parked on `wake`
+    int closed;
+    pthread_mutex_t lock; // Guards the injector, sleepers and closed
+    pthread_cond_t wake;
+    pthread_cond_t not_full;
+} WorkPool;
+
+int work_pool_init(WorkPool *pool, int workers, size_t injector_capacity);
+int work_pool_submit(WorkPool *pool, void *task);
+void *work_pool_next(WorkPool *pool, int worker);
+void work_pool_close(WorkPool *pool);
+void work_pool_destroy(WorkPool *pool);
+
+#endif